@@ -0,0 +1,39 @@
+#ifndef XYPHER_COMPILE_CACHE_H
+#define XYPHER_COMPILE_CACHE_H
+
+#include "Common.h"
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringRef.h>
+
+namespace xypher {
+
+// ccache-style cache for the whole pipeline: maps a hash of a source file plus
+// everything else that decides its object code (options, target, stdlib
+// declarations, the compiler binary) to the objects it compiled to. A hit skips
+// lexing, parsing, sema, codegen and optimization entirely.
+//
+// Units that produced warnings are not stored, so a hit never hides a warning the
+// original compile printed. The cache has no size bound and never evicts; remove
+// the directory to reclaim space.
+class CompileCache {
+public:
+    explicit CompileCache(String directory);
+
+    // ~/.cache/xypher/compile (or the platform equivalent); empty if it can't be determined.
+    static String defaultDirectory();
+
+    // `context` must describe every setting besides the source that changes the output
+    String computeKey(llvm::StringRef source, const String& context) const;
+
+    bool lookup(const String& key, Vec<llvm::SmallVector<char, 0>>& objects) const;
+    void store(const String& key, const Vec<llvm::SmallVector<char, 0>>& objects) const;
+
+private:
+    String directory_;
+
+    String getEntryPath(const String& key) const;
+};
+
+} // namespace xypher
+
+#endif
@@ -2,29 +2,89 @@
 #define XYPHER_JIT_H
 
 #include "Common.h"
+#include "backend/ObjectCache.h"
+#include "backend/TargetMachine.h"
+#include <llvm/ExecutionEngine/Orc/IndirectionUtils.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 namespace xypher {
 
+struct JITOptions {
+    bool tiered = false;             // Start every function at -O0, recompile hot ones at -O3
+    uint32_t tierUpThreshold = 1000; // Calls before a function is queued for recompilation
+    String cacheDirectory;           // Persistent object cache; empty disables it
+    TargetConfig target;             // Empty CPU means the host CPU; codegen level is set per tier
+};
+
 class JITEngine {
 public:
-    JITEngine();
+    explicit JITEngine(const JITOptions& options = JITOptions());
     ~JITEngine();
-    
-    bool addModule(Unique<llvm::Module> module);
+
+    bool isReady() const { return jit_ != nullptr; }
+
+    // The module must have been created in `context`; the JIT takes ownership of both.
+    // Function bodies are compiled lazily, each on its first call.
+    bool addModule(Unique<llvm::Module> module, Unique<llvm::LLVMContext> context);
+
+    // Makes the exported symbols of a shared library (e.g. libxystd) visible to JIT'd code.
+    bool addLibrary(const String& path);
+
     void* lookup(const String& name);
-    
+
+    // Calls the JIT'd `main` with C-style argc/argv built from programName + args.
+    int runMain(const String& programName, const Vec<String>& args);
+
     template<typename FuncType>
     FuncType getFunction(const String& name) {
         return reinterpret_cast<FuncType>(lookup(name));
     }
-    
+
 private:
-    Unique<llvm::orc::LLJIT> jit_;
+    struct TieredFunction {
+        String name;
+        size_t moduleIndex; // Into pristineModules_
+        bool queued = false;
+    };
+
+    JITOptions options_;
+    Unique<PersistentObjectCache> objectCache_;
+    Unique<llvm::orc::LLLazyJIT> jit_;
+
+    // Tiered mode: callers always go through a stub per function, which starts
+    // out pointing at the lazily compiled -O0 body and is later swapped to -O3.
+    Unique<llvm::orc::IndirectStubsManager> stubs_;
+    Vec<Unique<llvm::MemoryBuffer>> pristineModules_; // Unoptimized bitcode to recompile from
+    Vec<TieredFunction> tieredFunctions_;
+
+    std::thread tierUpThread_;
+    std::mutex tierUpMutex_;
+    std::condition_variable tierUpReady_;
+    std::deque<uint32_t> tierUpQueue_;
+    bool shuttingDown_ = false;
+
+    bool setUpTiering();
+    bool addTieredModule(Unique<llvm::Module> module, Unique<llvm::LLVMContext> context);
+    void instrumentCallCounter(llvm::Function* func, uint32_t id);
+    void tierUpLoop();
+    bool recompileOptimized(uint32_t id, llvm::TargetMachine& targetMachine,
+                            PersistentObjectCache* cache);
+
+    static void requestTierUp(JITEngine* engine, uint32_t id);
+
+    Unique<PersistentObjectCache> createObjectCache(const llvm::TargetMachine& targetMachine);
+    void reportError(llvm::Error err);
 };
 
 }
 
 #endif
-
@@ -0,0 +1,40 @@
+#ifndef XYPHER_LINKER_H
+#define XYPHER_LINKER_H
+
+#include "Common.h"
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Module.h>
+
+namespace xypher {
+
+enum class LinkResult {
+    Success,
+    Failure,    // The linker ran and reported errors
+    Unavailable // No in-process linker for this host; use the external driver
+};
+
+struct LinkJob {
+    Vec<llvm::StringRef> objectBuffers; // In-memory objects, e.g. from LLVMBackend::emitObject
+    Vec<String> objectFiles;
+    String outputFile;
+    String stdLibDir; // Directory containing libxystd; empty to link without it
+    bool gcSections = false;
+    bool strip = false;
+};
+
+class Linker {
+public:
+    // Links an executable with the embedded LLD ELF driver, without spawning any process.
+    static LinkResult linkInProcess(const LinkJob& job);
+
+    // Link-time optimization against the standard library: copies the xystd
+    // definitions `module` uses from the bitcode build of the library into it, as
+    // internal symbols the optimizer can inline and then drop. Functions that touch
+    // the library's mutable globals (directly or through calls) are left to the
+    // shared library, so there is still only one copy of its state.
+    static bool linkStdLibBitcode(llvm::Module& module, const String& bitcodeFile);
+};
+
+} // namespace xypher
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef XYPHER_OBJECT_CACHE_H
+#define XYPHER_OBJECT_CACHE_H
+
+#include "Common.h"
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <mutex>
+
+namespace xypher {
+
+// Stores JIT-compiled objects on disk, keyed by a hash of the module's bitcode plus
+// a salt describing everything else that affects codegen (target, CPU, opt level).
+// The directory is pruned when it's opened: objects unused for a week go, and the
+// least recently used ones once the cache outgrows 512 MiB.
+class PersistentObjectCache : public llvm::ObjectCache {
+public:
+    PersistentObjectCache(String directory, String salt);
+
+    // ~/.cache/xypher (or the platform equivalent); empty if it can't be determined.
+    static String defaultDirectory();
+
+    void notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object) override;
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) override;
+
+private:
+    String directory_;
+    String salt_;
+
+    std::mutex mutex_;
+    Map<const llvm::Module*, String> pendingKeys_; // getObject misses awaiting their object
+
+    String computeKey(const llvm::Module* module) const;
+    String getObjectPath(const String& key) const;
+};
+
+} // namespace xypher
+
+#endif
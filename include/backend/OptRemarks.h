@@ -0,0 +1,41 @@
+#ifndef XYPHER_OPT_REMARKS_H
+#define XYPHER_OPT_REMARKS_H
+
+#include "Common.h"
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/Support/ToolOutputFile.h>
+
+namespace xypher {
+
+struct RemarkOptions {
+    String file;          // --opt-remarks=<file>: every remark, serialized as YAML
+    String passedPattern; // -Rpass=<regex>: print applied optimizations of matching passes
+    String missedPattern; // -Rpass-missed=<regex>: print missed optimizations of matching passes
+
+    bool enabled() const {
+        return !file.empty() || !passedPattern.empty() || !missedPattern.empty();
+    }
+};
+
+// Routes the optimization remarks LLVM produces for one LLVMContext to a YAML
+// file and/or stderr (`file:line:col: remark: ... [-Rpass=pass]`). Locations come
+// from the module's debug info, so the module should be generated with at least
+// DebugInfoLevel::LocationsOnly. Keep the object alive until the module has
+// been optimized and emitted; the YAML file is completed when it is destroyed.
+class OptRemarks {
+public:
+    // Returns null (after printing why) if the file or a pattern is unusable
+    static Unique<OptRemarks> enable(llvm::LLVMContext& context, const RemarkOptions& options);
+
+    ~OptRemarks();
+
+private:
+    OptRemarks(llvm::LLVMContext& context, Unique<llvm::ToolOutputFile> file);
+
+    llvm::LLVMContext& context_;
+    Unique<llvm::ToolOutputFile> file_;
+};
+
+} // namespace xypher
+
+#endif
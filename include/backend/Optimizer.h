@@ -4,6 +4,10 @@
 #include "Common.h"
 
 #include <llvm/IR/Module.h>
+#include <llvm/IR/PassInstrumentation.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <ostream>
 
 namespace xypher {
 
@@ -16,12 +20,52 @@ enum class OptimizationLevel {
     Oz = 5  // Aggressive size optimization
 };
 
+// Instrumentation-based profile-guided optimization
+struct ProfileOptions {
+    bool generate = false; // --profile-generate: insert counters into the program
+    String generateFile;   // Raw profile the program writes; empty means default_%m.profraw
+    String useFile;        // --profile-use: merged .profdata to optimize with
+
+    bool enabled() const {
+        return generate || !useFile.empty();
+    }
+};
+
+// Size and shape of a module's definitions, taken before and after optimization
+// so --print-stats can show what the pipeline did.
+struct ModuleStats {
+    size_t functions = 0; // Definitions only
+    size_t basicBlocks = 0;
+    size_t instructions = 0;
+    size_t calls = 0; // Debug intrinsics excluded
+    size_t allocas = 0;
+    size_t loads = 0;
+    size_t stores = 0;
+    size_t vectorInstructions = 0; // Producing or consuming a vector value
+    Map<String, size_t> functionSizes; // Instructions per defined function
+};
+
 class Optimizer {
   public:
-    static void optimize(llvm::Module* module, OptimizationLevel level);
-    static void optimizeWithPipeline(llvm::Module* module, OptimizationLevel level);
+    // With a target machine the cost-model driven passes (vectorizers, unrolling,
+    // inlining) see the real target's TTI; without one they fall back to defaults.
+    // `instrumentation` hooks every pass run (e.g. TimePassesHandler). With
+    // `profile` the module is either instrumented or optimized with the profile;
+    // instrumented and profile-using builds must use the same pipeline and level.
+    static void optimize(llvm::Module* module, OptimizationLevel level,
+                         llvm::TargetMachine* targetMachine = nullptr,
+                         llvm::PassInstrumentationCallbacks* instrumentation = nullptr,
+                         const ProfileOptions& profile = ProfileOptions());
+    static void optimizeWithPipeline(llvm::Module* module, OptimizationLevel level,
+                                     llvm::TargetMachine* targetMachine = nullptr,
+                                     llvm::PassInstrumentationCallbacks* instrumentation = nullptr,
+                                     const ProfileOptions& profile = ProfileOptions());
     static bool verifyModule(llvm::Module* module, bool fatal = false);
-    static void printOptimizationStats(llvm::Module* module);
+
+    static ModuleStats collectStats(const llvm::Module& module);
+    // Prints the module-wide counts and a per-function size delta against `before`.
+    static void printOptimizationStats(const ModuleStats& before, llvm::Module* module,
+                                       std::ostream& out);
 };
 
 } // namespace xypher
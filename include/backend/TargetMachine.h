@@ -6,17 +6,44 @@
 
 namespace xypher {
 
+struct TargetConfig {
+    String triple;   // Empty: the host's default triple
+    String cpu;      // Empty: "generic"; "native": the host CPU and all of its features
+    String features; // Extra subtarget features, e.g. "+avx2,+fma"
+    llvm::CodeGenOptLevel codeGenLevel = llvm::CodeGenOptLevel::Default;
+};
+
 class TargetMachineManager {
 public:
+    // Registers the targets; cheap to call more than once
     static void initialize();
-    static llvm::TargetMachine* createTargetMachine(
+
+    // The shared target machine for `config`, created on first use and owned by
+    // the manager. A TargetMachine can't run codegen on two threads at once, so
+    // each thread gets its own; the pointer is valid until that thread exits.
+    static llvm::TargetMachine* getTargetMachine(const TargetConfig& config = TargetConfig());
+
+    // For short-lived threads, whose thread-local machine would be rebuilt every
+    // time: borrows an idle machine for `config` from a process-wide pool (creating
+    // one if none is idle). The caller uses it on one thread at a time and hands
+    // it back with returnTargetMachine when done.
+    static Unique<llvm::TargetMachine> borrowTargetMachine(const TargetConfig& config);
+    static void returnTargetMachine(const TargetConfig& config,
+                                    Unique<llvm::TargetMachine> targetMachine);
+
+    // A fresh target machine owned by the caller
+    static Unique<llvm::TargetMachine> createTargetMachine(
         const String& targetTriple = "",
         const String& cpu = "",
-        const String& features = ""
+        const String& features = "",
+        llvm::CodeGenOptLevel codeGenLevel = llvm::CodeGenOptLevel::Default
     );
+    static Unique<llvm::TargetMachine> createTargetMachine(const TargetConfig& config);
+
+    // Feature string for the host CPU, e.g. "+sse4.2,+avx2,-avx512f"
+    static String getHostFeatures();
 };
 
 } // namespace xypher
 
 #endif
-
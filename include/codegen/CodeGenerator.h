@@ -4,9 +4,11 @@
 #include "Common.h"
 #include "ast/AST.h"
 #include "ast/ASTVisitor.h"
+#include "backend/TargetMachine.h"
 #include "frontend/Diagnostics.h"
 #include "sema/ModuleRegistry.h"
 
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
@@ -16,9 +18,19 @@
 
 namespace xypher {
 
+// How much debug information the generated IR carries
+enum class DebugInfoLevel {
+    None,
+    LocationsOnly, // Source locations for optimization remarks; nothing is emitted as DWARF
+    Full,          // DWARF with functions, lines and variables for gdb and perf (--debug)
+};
+
 class CodeGenerator : public ASTVisitor {
   public:
-    CodeGenerator(const String& moduleName, DiagnosticEngine& diags);
+    // `moduleName` is the source file path; debug info refers back to it.
+    // `optimized` marks the debug info as describing optimized code.
+    CodeGenerator(const String& moduleName, DiagnosticEngine& diags,
+                  DebugInfoLevel debugInfo = DebugInfoLevel::None, bool optimized = false);
     ~CodeGenerator();
 
     bool generate(Program* program);
@@ -27,8 +39,18 @@ class CodeGenerator : public ASTVisitor {
         return module_.get();
     }
 
+    // Transfers ownership of the module and its context (e.g. to the JIT).
+    // Take the module first; the generator is unusable afterwards.
+    Unique<llvm::Module> takeModule();
+    Unique<llvm::LLVMContext> takeContext();
+
     void emitLLVMIR(const String& filename);
-    bool compileToObject(const String& filename);
+    bool compileToObject(const String& filename, const TargetConfig& target = TargetConfig());
+    bool compileToObject(llvm::SmallVectorImpl<char>& buffer,
+                         const TargetConfig& target = TargetConfig());
+    // Parallel codegen over `parts` pieces of the module (see LLVMBackend::emitObjects)
+    bool compileToObjects(Vec<llvm::SmallVector<char, 0>>& objects, unsigned parts,
+                          const TargetConfig& target = TargetConfig());
     bool linkToExecutable(const String& objFile, const String& exeFile);
 
     void visit(IntegerLiteral* node) override;
@@ -58,16 +80,23 @@ class CodeGenerator : public ASTVisitor {
 
   private:
     DiagnosticEngine& diags_;
+    const SourceManager& sources_; // Decodes node locations for debug info
 
     Unique<llvm::LLVMContext> context_;
     Unique<llvm::Module> module_;
     Unique<llvm::IRBuilder<>> builder_;
+    DebugInfoLevel debugInfo_;
+    bool optimized_;
+    Unique<llvm::DIBuilder> debugBuilder_; // Null without debug info
+    llvm::DICompileUnit* debugUnit_ = nullptr;
+    llvm::DIFile* debugFile_ = nullptr;
+    Map<String, llvm::DIType*> debugTypes_;
 
     Map<String, llvm::AllocaInst*> namedValues_;
     Map<String, llvm::GlobalVariable*> globalValues_;
     Map<String, llvm::Function*> functions_;
     Set<String> importedModules_;
-    ModuleRegistry moduleRegistry_;
+    const ModuleRegistry& moduleRegistry_ = ModuleRegistry::instance();
     
     llvm::Value* currentValue_ = nullptr;
     llvm::Function* currentFunction_ = nullptr;
@@ -80,6 +109,15 @@ class CodeGenerator : public ASTVisitor {
     void declareBuiltins();
     void declareModuleFunctions(const String& moduleName);
 
+    // Attaches `node`'s source location to the instructions emitted next
+    void emitLocation(const ASTNode* node);
+    llvm::DISubprogram* createDebugFunction(FuncDecl* node, llvm::Function* func);
+    llvm::DIType* getDebugType(const String& typeName);
+    // Describes a local (argNo 0) or parameter (argNo from 1) stored in `alloca`
+    void declareDebugVariable(const String& name, const String& typeName,
+                              llvm::AllocaInst* alloca, const SourceLocation& loc,
+                              unsigned argNo = 0);
+
     void error(const String& message);
 };
 
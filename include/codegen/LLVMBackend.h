@@ -2,16 +2,38 @@
 #define XYPHER_LLVM_BACKEND_H
 
 #include "Common.h"
+#include "backend/TargetMachine.h"
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Support/raw_ostream.h>
 
 namespace xypher {
 
 class LLVMBackend {
 public:
     static bool emitLLVMIR(llvm::Module* module, const String& filename);
-    static bool emitAssembly(llvm::Module* module, const String& filename);
-    static bool emitObject(llvm::Module* module, const String& filename);
+    static bool emitAssembly(llvm::Module* module, const String& filename,
+                             const TargetConfig& target = TargetConfig());
+    static bool emitObject(llvm::Module* module, const String& filename,
+                           const TargetConfig& target = TargetConfig());
+    static bool emitObject(llvm::Module* module, llvm::SmallVectorImpl<char>& buffer,
+                           const TargetConfig& target = TargetConfig());
+    static bool emitObject(llvm::Module* module, llvm::raw_pwrite_stream& dest,
+                           const TargetConfig& target = TargetConfig());
+
+    // Splits the module into up to `parts` pieces and runs codegen for them on
+    // parallel threads, one relocatable object per piece. The objects have to be
+    // linked together. Internal symbols stay internal: a local global always
+    // lands in the same piece as everything that references it, so objects from
+    // different input files can be linked into one program without clashes.
+    static bool emitObjects(llvm::Module* module, unsigned parts,
+                            Vec<llvm::SmallVector<char, 0>>& objects,
+                            const TargetConfig& target = TargetConfig());
     static bool optimize(llvm::Module* module, int optLevel);
+
+private:
+    static bool emitObject(llvm::Module* module, llvm::raw_pwrite_stream& dest,
+                           llvm::TargetMachine& targetMachine);
 };
 
 } // namespace xypher
@@ -0,0 +1,37 @@
+#ifndef XYPHER_COMPILE_SERVER_H
+#define XYPHER_COMPILE_SERVER_H
+
+#include "Common.h"
+
+#include <functional>
+
+namespace xypher {
+
+// `xypc --serve <socket>` keeps one warm compiler process around so that short
+// compiles don't pay for process startup and LLVM initialization every time.
+// A client sends its working directory, its arguments and its stdin/stdout/stderr
+// over a Unix socket; the server forks a child that runs the request against
+// those descriptors and replies with the exit code. Forking keeps every request
+// isolated (cwd, exit(), crashes) while sharing whatever the server warmed up.
+// `xypc` itself can act as the client, but it still loads libLLVM on every start;
+// `xypc-client` (src/client.cpp) forwards without linking LLVM at all.
+class CompileServer {
+public:
+    using CompileFunction = std::function<int(const Vec<String>& args)>;
+
+    // Serves requests until the process is terminated. Returns only on setup errors.
+    static int serve(const String& socketPath, const CompileFunction& compile);
+
+    // Runs `args` on the server listening at `socketPath` and returns its exit code,
+    // or nothing when no server is listening there.
+    static Optional<int> forward(const String& socketPath, const Vec<String>& args);
+
+    // Removes `--connect <socket>` from `args` and returns the socket; falls back to
+    // $XYPC_SERVER so a build system can switch to the server without changing its
+    // command lines. Empty when neither is set.
+    static String takeServerSocket(Vec<String>& args);
+};
+
+} // namespace xypher
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "Common.h"
 #include "frontend/SourceLocation.h"
+#include "frontend/SourceManager.h"
 
 namespace xypher {
 
@@ -28,7 +29,7 @@ public:
     
     const Vec<String>& getSuggestions() const { return suggestions_; }
     
-    String format() const;
+    String format(const SourceManager& sources) const;
     
 private:
     DiagnosticLevel level_;
@@ -39,6 +40,10 @@ private:
 
 class DiagnosticEngine {
 public:
+    explicit DiagnosticEngine(const SourceManager& sources) : sources_(sources) {}
+    
+    const SourceManager& getSourceManager() const { return sources_; }
+    
     void report(DiagnosticLevel level, const String& message, SourceLocation loc);
     
     void note(const String& message, SourceLocation loc) {
@@ -67,6 +72,7 @@ public:
     void clear();
     
 private:
+    const SourceManager& sources_;
     Vec<Diagnostic> diagnostics_;
     bool hasErrors_ = false;
     size_t errorCount_ = 0;
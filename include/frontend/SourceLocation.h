@@ -3,26 +3,33 @@
 
 #include "Common.h"
 
+#include <cstdint>
+
 namespace xypher {
 
+// Index of a file in its SourceManager; 0 means no file
+using FileId = uint32_t;
+
+// A byte offset into a file, 8 bytes in total. Line and column are only worked
+// out on demand, by the SourceManager that owns the file.
 class SourceLocation {
 public:
     SourceLocation() = default;
-    SourceLocation(String filename, size_t line, size_t column)
-        : filename_(std::move(filename)), line_(line), column_(column) {}
+    SourceLocation(FileId file, uint32_t offset) : file_(file), offset_(offset) {}
     
-    const String& getFilename() const { return filename_; }
-    size_t getLine() const { return line_; }
-    size_t getColumn() const { return column_; }
+    FileId getFileId() const { return file_; }
+    uint32_t getOffset() const { return offset_; }
     
-    String toString() const {
-        return filename_ + ":" + std::to_string(line_) + ":" + std::to_string(column_);
+    bool isValid() const { return file_ != 0; }
+    
+    bool operator==(const SourceLocation& other) const {
+        return file_ == other.file_ && offset_ == other.offset_;
     }
+    bool operator!=(const SourceLocation& other) const { return !(*this == other); }
     
 private:
-    String filename_;
-    size_t line_ = 0;
-    size_t column_ = 0;
+    FileId file_ = 0;
+    uint32_t offset_ = 0;
 };
 
 class SourceRange {
@@ -41,4 +48,3 @@ private:
 } // namespace xypher
 
 #endif
-
@@ -0,0 +1,49 @@
+#ifndef XYPHER_SOURCE_MANAGER_H
+#define XYPHER_SOURCE_MANAGER_H
+
+#include "Common.h"
+#include "frontend/SourceLocation.h"
+
+namespace xypher {
+
+// 1-based, as printed in diagnostics; 0 for an invalid location
+struct LineAndColumn {
+    uint32_t line = 0;
+    uint32_t column = 0;
+};
+
+// Owns the name of every file in one compilation and a view of its text, so that
+// tokens and AST nodes refer to a file by a 32-bit FileId instead of each carrying
+// a copy of its name. The text is not copied and must outlive the manager's users.
+//
+// Locations are plain byte offsets; the first time a file's line or column is
+// asked for, a table of line start offsets is built for it, and lookups after
+// that are a binary search.
+class SourceManager {
+public:
+    // Files must be smaller than 4 GiB (see SourceLocation)
+    FileId addFile(String filename, StringView text);
+
+    const String& getFilename(FileId file) const;
+    StringView getText(FileId file) const;
+
+    LineAndColumn getLineAndColumn(const SourceLocation& loc) const;
+
+    // "file:line:column", as diagnostics print it
+    String format(const SourceLocation& loc) const;
+
+private:
+    struct FileEntry {
+        String filename;
+        StringView text;
+        mutable Vec<uint32_t> lineStarts; // Empty until first needed
+    };
+
+    Vec<FileEntry> files_; // files_[id - 1]
+
+    const FileEntry* getEntry(FileId file) const;
+};
+
+} // namespace xypher
+
+#endif
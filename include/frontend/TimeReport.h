@@ -0,0 +1,92 @@
+#ifndef XYPHER_TIME_REPORT_H
+#define XYPHER_TIME_REPORT_H
+
+#include "Common.h"
+
+#include <llvm/Support/TimeProfiler.h>
+
+#include <array>
+#include <chrono>
+#include <mutex>
+
+namespace xypher {
+
+enum class CompilePhase {
+    Read,
+    Lex,
+    Parse,
+    Sema,
+    CodeGen,
+    Optimize,
+    Emit,
+    Link
+};
+
+constexpr size_t CompilePhaseCount = static_cast<size_t>(CompilePhase::Link) + 1;
+
+const char* compilePhaseName(CompilePhase phase);
+
+struct PhaseTimes {
+    double wall = 0.0;   // Seconds
+    double user = 0.0;   // CPU seconds in user mode
+    double system = 0.0; // CPU seconds in the kernel
+
+    PhaseTimes& operator+=(const PhaseTimes& other);
+    PhaseTimes operator*(double factor) const;
+};
+
+// Wall time and CPU time of the calling thread since construction
+class Stopwatch {
+public:
+    Stopwatch();
+    PhaseTimes elapsed() const;
+
+private:
+    std::chrono::steady_clock::time_point wallStart_;
+    PhaseTimes cpuStart_;
+};
+
+// --time-report: wall time, CPU time and peak RSS per compiler phase. Files are
+// compiled in parallel, so the times of a phase are summed over all threads.
+class TimeReport {
+public:
+    // Times one phase on the current thread, into `report` unless it is null and as
+    // a --time-trace span when the time profiler is running
+    class Scope {
+    public:
+        Scope(TimeReport* report, CompilePhase phase)
+            : report_(report), phase_(phase), traceScope_(compilePhaseName(phase)) {}
+        ~Scope() {
+            if (report_) {
+                report_->add(phase_, stopwatch_.elapsed());
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        TimeReport* report_;
+        CompilePhase phase_;
+        llvm::TimeTraceScope traceScope_;
+        Stopwatch stopwatch_;
+    };
+
+    void add(CompilePhase phase, const PhaseTimes& times);
+
+    // Per-pass timings of one module (LLVM's TimePassesHandler output), printed
+    // after the phase table
+    void addPassTimings(const String& report);
+
+    void print(std::ostream& os) const;
+
+private:
+    mutable std::mutex mutex_;
+    Vec<String> passTimings_;
+    std::array<PhaseTimes, CompilePhaseCount> phases_{};
+    std::array<size_t, CompilePhaseCount> peakRSS_{}; // Bytes, process-wide, as of the phase's end
+};
+
+} // namespace xypher
+
+#endif
@@ -3,13 +3,14 @@
 
 #include "Common.h"
 #include "lexer/Token.h"
-#include "frontend/SourceLocation.h"
+#include "frontend/SourceManager.h"
 
 namespace xypher {
 
 class Lexer {
 public:
-    explicit Lexer(String source, String filename = "<input>");
+    // Lexes `file`'s text in place; the text must outlive the lexer and its tokens
+    Lexer(const SourceManager& sources, FileId file);
     
     Token nextToken();
     Token peekToken(size_t ahead = 0);
@@ -35,24 +36,17 @@ private:
     Token identifier();
     
     TokenType identifierType();
-    TokenType checkKeyword(size_t start, size_t length, 
-                          const String& rest, TokenType type);
     
     void addError(const String& message);
     
-    String source_;
-    String filename_;
+    const SourceManager& sources_;
+    FileId file_;
+    StringView source_;
     size_t start_ = 0;
     size_t current_ = 0;
-    size_t line_ = 1;
-    size_t column_ = 1;
     
     bool hasErrors_ = false;
     Vec<String> errors_;
-    
-    Map<String, TokenType> keywords_;
-    
-    void initKeywords();
 };
 
 } // namespace xypher
@@ -2,7 +2,7 @@
 #define XYPHER_TOKEN_H
 
 #include "Common.h"
-#include "frontend/SourceLocation.h"
+#include "frontend/SourceManager.h"
 
 namespace xypher {
 
@@ -124,15 +124,17 @@ enum class TokenType {
     At,         // @
 };
 
+// Trivially copyable: the lexeme points into the source text, which must outlive
+// the token, and the location names its file by id.
 class Token {
   public:
-    Token(TokenType type, String lexeme, SourceLocation loc)
-        : type_(type), lexeme_(std::move(lexeme)), location_(loc) {}
+    Token(TokenType type, StringView lexeme, SourceLocation loc)
+        : type_(type), lexeme_(lexeme), location_(loc) {}
 
     TokenType getType() const {
         return type_;
     }
-    const String& getLexeme() const {
+    StringView getLexeme() const {
         return lexeme_;
     }
     const SourceLocation& getLocation() const {
@@ -158,11 +160,11 @@ class Token {
     bool isOperator() const;
     bool isType() const;
 
-    String toString() const;
+    String toString(const SourceManager& sources) const;
 
   private:
     TokenType type_;
-    String lexeme_;
+    StringView lexeme_;
     SourceLocation location_;
 };
 
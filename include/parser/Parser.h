@@ -7,17 +7,21 @@
 #include "ast/AST.h"
 #include "frontend/Diagnostics.h"
 
+#include <chrono>
+
 namespace xypher {
 
 class Parser {
 public:
-    Parser(Lexer& lexer, DiagnosticEngine& diags);
+    // With `lexTime`, the time spent waiting for tokens is added to it (--time-report)
+    Parser(Lexer& lexer, DiagnosticEngine& diags, std::chrono::nanoseconds* lexTime = nullptr);
     
     Unique<Program> parseProgram();
     
 private:
     Lexer& lexer_;
     DiagnosticEngine& diags_;
+    std::chrono::nanoseconds* lexTime_;
     Token current_;
     Token previous_;
     
@@ -18,10 +18,16 @@ enum class ModuleType {
 class ModuleRegistry {
 public:
     ModuleRegistry() { initializeModules(); }
+
+    // Process-wide registry; built once and read-only afterwards
+    static const ModuleRegistry& instance();
     
     Vec<Symbol> getModuleFunctions(const String& moduleName) const;
     Vec<Symbol> getCoreFunctions() const;
     bool isValidModule(const String& moduleName) const;
+
+    // Every declaration in a stable order, for cache keys
+    String fingerprint() const;
     
 private:
     Map<String, Vec<Symbol>> moduleMap_;
@@ -46,7 +46,7 @@ class SemanticAnalyzer : public ASTVisitor {
   private:
     DiagnosticEngine& diags_;
     SymbolTable symbols_;
-    ModuleRegistry moduleRegistry_;
+    const ModuleRegistry& moduleRegistry_ = ModuleRegistry::instance();
     Map<Expr*, String> exprTypes_;
     String currentFunction_;
     String currentReturnType_;
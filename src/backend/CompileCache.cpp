@@ -0,0 +1,130 @@
+#include "backend/CompileCache.h"
+#include "backend/ObjectCache.h"
+
+#include "XypherConfig.h"
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA256.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cstring>
+
+namespace xypher {
+
+namespace {
+
+// Entry layout: magic, object count, then each object as [u64 size][bytes]
+const char EntryMagic[4] = {'X', 'Y', 'C', '1'};
+
+// Path, size and mtime of the running xypc, so that a rebuilt compiler never
+// reuses objects from the old one even when the version string didn't change
+const String& compilerIdentity() {
+    static const String identity = [] {
+        static int anchor;
+        String path = llvm::sys::fs::getMainExecutable(nullptr, &anchor);
+        llvm::sys::fs::file_status status;
+        if (path.empty() || llvm::sys::fs::status(path, status)) {
+            return path;
+        }
+        return path + " " + std::to_string(status.getSize()) + " " +
+               std::to_string(status.getLastModificationTime().time_since_epoch().count());
+    }();
+    return identity;
+}
+
+} // namespace
+
+CompileCache::CompileCache(String directory) : directory_(std::move(directory)) {
+    llvm::sys::fs::create_directories(directory_);
+}
+
+String CompileCache::defaultDirectory() {
+    String base = PersistentObjectCache::defaultDirectory();
+    if (base.empty()) {
+        return "";
+    }
+
+    llvm::SmallString<256> path(base);
+    llvm::sys::path::append(path, "compile");
+    return String(path.str());
+}
+
+String CompileCache::computeKey(llvm::StringRef source, const String& context) const {
+    llvm::SHA256 hasher;
+    hasher.update(XYPHER_VERSION_STRING "\n" LLVM_VERSION_STRING "\n");
+    hasher.update(compilerIdentity());
+    hasher.update("\n");
+    hasher.update(context);
+    hasher.update("\n");
+    hasher.update(source);
+    return llvm::toHex(hasher.final(), true);
+}
+
+String CompileCache::getEntryPath(const String& key) const {
+    llvm::SmallString<256> path(directory_);
+    llvm::sys::path::append(path, key + ".xyo");
+    return String(path.str());
+}
+
+bool CompileCache::lookup(const String& key, Vec<llvm::SmallVector<char, 0>>& objects) const {
+    auto buffer = llvm::MemoryBuffer::getFile(getEntryPath(key), false, false);
+    if (!buffer) {
+        return false;
+    }
+
+    llvm::StringRef data = (*buffer)->getBuffer();
+    uint32_t count;
+    if (data.size() < sizeof(EntryMagic) + sizeof(count) ||
+        std::memcmp(data.data(), EntryMagic, sizeof(EntryMagic)) != 0) {
+        return false;
+    }
+    std::memcpy(&count, data.data() + sizeof(EntryMagic), sizeof(count));
+    data = data.drop_front(sizeof(EntryMagic) + sizeof(count));
+
+    // Every object has at least its size field; a corrupt count mustn't allocate
+    if (count > data.size() / sizeof(uint64_t)) {
+        return false;
+    }
+
+    Vec<llvm::SmallVector<char, 0>> entry(count);
+    for (auto& object : entry) {
+        uint64_t size;
+        if (data.size() < sizeof(size)) {
+            return false;
+        }
+        std::memcpy(&size, data.data(), sizeof(size));
+        data = data.drop_front(sizeof(size));
+        if (data.size() < size) {
+            return false;
+        }
+        object.assign(data.begin(), data.begin() + size);
+        data = data.drop_front(size);
+    }
+
+    for (auto& object : entry) {
+        objects.push_back(std::move(object));
+    }
+    return true;
+}
+
+void CompileCache::store(const String& key, const Vec<llvm::SmallVector<char, 0>>& objects) const {
+    // Written to a temporary and renamed, so concurrent builds never see half an entry
+    auto err = llvm::writeToOutput(getEntryPath(key), [&](llvm::raw_ostream& os) {
+        uint32_t count = static_cast<uint32_t>(objects.size());
+        os.write(EntryMagic, sizeof(EntryMagic));
+        os.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& object : objects) {
+            uint64_t size = object.size();
+            os.write(reinterpret_cast<const char*>(&size), sizeof(size));
+            os.write(object.data(), object.size());
+        }
+        return llvm::Error::success();
+    });
+    llvm::consumeError(std::move(err));
+}
+
+} // namespace xypher
@@ -1,46 +1,485 @@
 #include "backend/JIT.h"
+#include "backend/Optimizer.h"
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/IRCompileLayer.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/TargetProcess/TargetExecutionUtils.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+
+#include <iostream>
 
 namespace xypher {
 
-JITEngine::JITEngine() {
+namespace {
+
+const char* const TierUpCallbackName = "__xy_tier_up";
+const char* const TierUpEngineName = "__xy_tier_engine";
+const char* const Tier0Suffix = "$tier0";
+const char* const Tier1Suffix = "$tier1";
+
+// Renames `func` to `func<suffix>` and points every use of the original name at a
+// fresh declaration, so calls resolve through the stub that owns the plain name.
+llvm::Function* detachDefinition(llvm::Function* func, const String& suffix) {
+    String name = func->getName().str();
+    func->setName(name + suffix);
+
+    llvm::Function* decl = llvm::Function::Create(
+        func->getFunctionType(), llvm::Function::ExternalLinkage, name, func->getParent());
+    func->replaceAllUsesWith(decl);
+    return func;
+}
+
+// JIT'd code only ever runs on this machine, so an unspecified CPU means the host's
+TargetConfig jitTargetConfig(TargetConfig target, llvm::CodeGenOptLevel codeGenLevel) {
+    if (target.cpu.empty()) {
+        target.cpu = "native";
+    }
+    target.codeGenLevel = codeGenLevel;
+    return target;
+}
+
+// Describes an existing target machine to LLJIT, which wants a builder
+llvm::orc::JITTargetMachineBuilder describeTarget(const llvm::TargetMachine& targetMachine) {
+    llvm::orc::JITTargetMachineBuilder jtmb(targetMachine.getTargetTriple());
+    jtmb.setCPU(targetMachine.getTargetCPU().str());
+    jtmb.getFeatures() = llvm::SubtargetFeatures(targetMachine.getTargetFeatureString());
+    jtmb.setRelocationModel(targetMachine.getRelocationModel());
+    jtmb.setCodeGenOptLevel(targetMachine.getOptLevel());
+    jtmb.setOptions(targetMachine.Options);
+    return jtmb;
+}
+
+// Lazy materialization normally compiles on the thread that first calls a
+// function, but the tier-up thread can trigger it too, and one TargetMachine
+// must never run two codegens at once.
+class SerializedCompiler : public llvm::orc::SimpleCompiler {
+public:
+    using SimpleCompiler::SimpleCompiler;
+
+    llvm::Expected<CompileResult> operator()(llvm::Module& module) override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return SimpleCompiler::operator()(module);
+    }
+
+private:
+    std::mutex mutex_;
+};
+
+} // namespace
+
+JITEngine::JITEngine(const JITOptions& options) : options_(options) {
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmPrinter();
     llvm::InitializeNativeTargetAsmParser();
-    
-    auto jitOrErr = llvm::orc::LLJITBuilder().create();
+
+    // Tier 0 favours compile speed; hot functions get a separate -O3 codegen later
+    llvm::TargetMachine* targetMachine = TargetMachineManager::getTargetMachine(jitTargetConfig(
+        options_.target,
+        options_.tiered ? llvm::CodeGenOptLevel::None : llvm::CodeGenOptLevel::Default));
+    if (!targetMachine) {
+        std::cerr << "[JIT] Error: Could not create target machine" << std::endl;
+        return;
+    }
+
+    objectCache_ = createObjectCache(*targetMachine);
+
+    // Codegen through the shared target machine, plus the on-disk cache: a repeat
+    // run of an unchanged script loads its objects instead of running codegen again.
+    auto createCompiler = [targetMachine, cache = objectCache_.get()](
+                              llvm::orc::JITTargetMachineBuilder)
+        -> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+        return std::make_unique<SerializedCompiler>(*targetMachine, cache);
+    };
+
+    auto jitOrErr = llvm::orc::LLLazyJITBuilder()
+                        .setJITTargetMachineBuilder(describeTarget(*targetMachine))
+                        .setDataLayout(targetMachine->createDataLayout())
+                        .setCompileFunctionCreator(std::move(createCompiler))
+                        .create();
     if (!jitOrErr) {
+        reportError(jitOrErr.takeError());
         jit_ = nullptr;
         return;
     }
-    
+
     jit_ = std::move(*jitOrErr);
+
+    // Emit one partition per requested function: a body is lowered to machine
+    // code only when its lazy-reexport stub is first called.
+    jit_->setPartitionFunction(llvm::orc::CompileOnDemandLayer::compileRequested);
+
+    // Resolve libc symbols such as printf from the compiler process itself
+    auto processSymbols = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+        jit_->getDataLayout().getGlobalPrefix());
+    if (!processSymbols) {
+        reportError(processSymbols.takeError());
+        return;
+    }
+
+    jit_->getMainJITDylib().addGenerator(std::move(*processSymbols));
+
+    if (options_.tiered && !setUpTiering()) {
+        jit_ = nullptr;
+    }
 }
 
-JITEngine::~JITEngine() = default;
+JITEngine::~JITEngine() {
+    if (tierUpThread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(tierUpMutex_);
+            shuttingDown_ = true;
+        }
+        tierUpReady_.notify_all();
+        tierUpThread_.join();
+    }
+}
 
-bool JITEngine::addModule(Unique<llvm::Module> module) {
+Unique<PersistentObjectCache>
+JITEngine::createObjectCache(const llvm::TargetMachine& targetMachine) {
+    if (options_.cacheDirectory.empty()) {
+        return nullptr;
+    }
+
+    String salt = targetMachine.getTargetTriple().str() + ";" +
+                  targetMachine.getTargetCPU().str() + ";" +
+                  targetMachine.getTargetFeatureString().str() + ";" +
+                  std::to_string(static_cast<int>(targetMachine.getOptLevel()));
+    return makeUnique<PersistentObjectCache>(options_.cacheDirectory, salt);
+}
+
+void JITEngine::reportError(llvm::Error err) {
+    std::cerr << "[JIT] Error: " << llvm::toString(std::move(err)) << std::endl;
+}
+
+bool JITEngine::setUpTiering() {
+    stubs_ = llvm::orc::createLocalIndirectStubsManagerBuilder(jit_->getTargetTriple())();
+    if (!stubs_) {
+        std::cerr << "[JIT] Error: Tiered mode is not supported on this target" << std::endl;
+        return false;
+    }
+
+    // Instrumented -O0 code calls back into the engine once a function gets hot.
+    // The engine is passed by symbol rather than as an IR constant so the IR (and
+    // with it the object cache key) doesn't change from run to run.
+    llvm::orc::SymbolMap callbacks;
+    callbacks[jit_->mangleAndIntern(TierUpCallbackName)] = llvm::orc::ExecutorSymbolDef(
+        llvm::orc::ExecutorAddr::fromPtr(&JITEngine::requestTierUp),
+        llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+    callbacks[jit_->mangleAndIntern(TierUpEngineName)] = llvm::orc::ExecutorSymbolDef(
+        llvm::orc::ExecutorAddr::fromPtr(this), llvm::JITSymbolFlags::Exported);
+
+    if (auto err = jit_->getMainJITDylib().define(llvm::orc::absoluteSymbols(callbacks))) {
+        reportError(std::move(err));
+        return false;
+    }
+
+    tierUpThread_ = std::thread(&JITEngine::tierUpLoop, this);
+    return true;
+}
+
+bool JITEngine::addModule(Unique<llvm::Module> module, Unique<llvm::LLVMContext> context) {
     if (!jit_) return false;
-    
-    auto err = jit_->addIRModule(llvm::orc::ThreadSafeModule(
-        std::move(module), 
-        std::make_unique<llvm::LLVMContext>()
+
+    if (options_.tiered) {
+        return addTieredModule(std::move(module), std::move(context));
+    }
+
+    auto err = jit_->addLazyIRModule(llvm::orc::ThreadSafeModule(
+        std::move(module),
+        std::move(context)
     ));
-    
-    return !err;
+
+    if (err) {
+        reportError(std::move(err));
+        return false;
+    }
+
+    return true;
+}
+
+bool JITEngine::addTieredModule(Unique<llvm::Module> module, Unique<llvm::LLVMContext> context) {
+    module->setDataLayout(jit_->getDataLayout());
+#if LLVM_VERSION_MAJOR >= 21
+    module->setTargetTriple(jit_->getTargetTriple());
+#else
+    module->setTargetTriple(jit_->getTargetTriple().str());
+#endif
+
+    // Recompiled functions live in their own module, so mutable globals must be
+    // shared by name instead of being duplicated as internal copies.
+    for (auto& global : module->globals()) {
+        if (global.hasLocalLinkage() && !global.isConstant()) {
+            if (!global.hasName()) {
+                global.setName("__xy_global");
+            }
+            global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+        }
+    }
+
+    String bitcode;
+    llvm::raw_string_ostream os(bitcode);
+    llvm::WriteBitcodeToFile(*module, os);
+    os.flush();
+
+    Vec<llvm::Function*> definitions;
+    for (auto& func : *module) {
+        if (!func.isDeclaration()) {
+            definitions.push_back(&func);
+        }
+    }
+
+    Vec<String> names;
+    {
+        std::lock_guard<std::mutex> lock(tierUpMutex_);
+        size_t moduleIndex = pristineModules_.size();
+        pristineModules_.push_back(
+            llvm::MemoryBuffer::getMemBufferCopy(bitcode, module->getModuleIdentifier()));
+
+        for (auto* func : definitions) {
+            uint32_t id = static_cast<uint32_t>(tieredFunctions_.size());
+            names.push_back(func->getName().str());
+            tieredFunctions_.push_back({func->getName().str(), moduleIndex});
+
+            detachDefinition(func, Tier0Suffix);
+            instrumentCallCounter(func, id);
+        }
+    }
+
+    auto err = jit_->addLazyIRModule(llvm::orc::ThreadSafeModule(
+        std::move(module),
+        std::move(context)
+    ));
+    if (err) {
+        reportError(std::move(err));
+        return false;
+    }
+
+    // Looking up the -O0 bodies only yields their lazy-reexport stubs; nothing is
+    // compiled until the first call.
+    llvm::orc::IndirectStubsManager::StubInitsMap stubInits;
+    for (const auto& name : names) {
+        auto body = jit_->lookup(name + Tier0Suffix);
+        if (!body) {
+            reportError(body.takeError());
+            return false;
+        }
+        stubInits[name] = {*body,
+                           llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable};
+    }
+
+    if (auto err = stubs_->createStubs(stubInits)) {
+        reportError(std::move(err));
+        return false;
+    }
+
+    llvm::orc::SymbolMap stubSymbols;
+    for (const auto& name : names) {
+        stubSymbols[jit_->mangleAndIntern(name)] = stubs_->findStub(name, true);
+    }
+
+    if (auto err = jit_->getMainJITDylib().define(llvm::orc::absoluteSymbols(stubSymbols))) {
+        reportError(std::move(err));
+        return false;
+    }
+
+    return true;
+}
+
+void JITEngine::instrumentCallCounter(llvm::Function* func, uint32_t id) {
+    llvm::Module* module = func->getParent();
+    llvm::LLVMContext& context = module->getContext();
+    auto* i32Type = llvm::Type::getInt32Ty(context);
+    auto* ptrType = llvm::PointerType::get(context, 0);
+
+    auto* counter = new llvm::GlobalVariable(*module, i32Type, false,
+                                             llvm::GlobalValue::InternalLinkage,
+                                             llvm::ConstantInt::get(i32Type, 0),
+                                             func->getName() + ".calls");
+
+    llvm::Constant* engine = module->getOrInsertGlobal(TierUpEngineName,
+                                                       llvm::Type::getInt8Ty(context));
+    llvm::FunctionCallee callback = module->getOrInsertFunction(
+        TierUpCallbackName, llvm::Type::getVoidTy(context), ptrType, i32Type);
+
+    // Count after the entry allocas so they stay in the entry block
+    llvm::BasicBlock& entry = func->getEntryBlock();
+    auto insertPoint = entry.getFirstInsertionPt();
+    while (insertPoint != entry.end() && llvm::isa<llvm::AllocaInst>(*insertPoint)) {
+        ++insertPoint;
+    }
+
+    llvm::IRBuilder<> builder(&entry, insertPoint);
+    llvm::Value* calls = builder.CreateLoad(i32Type, counter);
+    calls = builder.CreateAdd(calls, builder.getInt32(1));
+    builder.CreateStore(calls, counter);
+    llvm::Value* isHot = builder.CreateICmpEQ(calls, builder.getInt32(options_.tierUpThreshold));
+
+    llvm::Instruction* hotPath =
+        llvm::SplitBlockAndInsertIfThen(isHot, &*builder.GetInsertPoint(), false);
+    builder.SetInsertPoint(hotPath);
+    builder.CreateCall(callback, {engine, builder.getInt32(id)});
+}
+
+void JITEngine::requestTierUp(JITEngine* engine, uint32_t id) {
+    {
+        std::lock_guard<std::mutex> lock(engine->tierUpMutex_);
+        TieredFunction& func = engine->tieredFunctions_[id];
+        if (func.queued) {
+            return;
+        }
+        func.queued = true;
+        engine->tierUpQueue_.push_back(id);
+    }
+    engine->tierUpReady_.notify_one();
+}
+
+void JITEngine::tierUpLoop() {
+    // Target machines are per thread, so the -O3 one is created here, on the only
+    // thread that uses it. Without it, functions simply stay at -O0.
+    llvm::TargetMachine* targetMachine = TargetMachineManager::getTargetMachine(
+        jitTargetConfig(options_.target, llvm::CodeGenOptLevel::Aggressive));
+    if (!targetMachine) {
+        std::cerr << "[JIT] Error: Could not create target machine for tier-up" << std::endl;
+        return;
+    }
+    Unique<PersistentObjectCache> cache = createObjectCache(*targetMachine);
+
+    while (true) {
+        uint32_t id;
+        {
+            std::unique_lock<std::mutex> lock(tierUpMutex_);
+            tierUpReady_.wait(lock, [this] { return shuttingDown_ || !tierUpQueue_.empty(); });
+            if (shuttingDown_) {
+                return;
+            }
+            id = tierUpQueue_.front();
+            tierUpQueue_.pop_front();
+        }
+
+        recompileOptimized(id, *targetMachine, cache.get());
+    }
+}
+
+bool JITEngine::recompileOptimized(uint32_t id, llvm::TargetMachine& targetMachine,
+                                   PersistentObjectCache* cache) {
+    String name;
+    const llvm::MemoryBuffer* bitcode;
+    {
+        std::lock_guard<std::mutex> lock(tierUpMutex_);
+        name = tieredFunctions_[id].name;
+        bitcode = pristineModules_[tieredFunctions_[id].moduleIndex].get();
+    }
+
+    // Each recompilation parses its own copy of the unoptimized IR, so it never
+    // touches the context the -O0 code is being compiled from.
+    llvm::LLVMContext context;
+    auto moduleOrErr = llvm::parseBitcodeFile(bitcode->getMemBufferRef(), context);
+    if (!moduleOrErr) {
+        reportError(moduleOrErr.takeError());
+        return false;
+    }
+    Unique<llvm::Module> module = std::move(*moduleOrErr);
+
+    llvm::Function* hot = module->getFunction(name);
+    if (!hot || hot->isDeclaration()) {
+        return false;
+    }
+
+    // Other bodies stay visible to the inliner but are never emitted here, and
+    // mutable globals resolve to the instances defined by the -O0 module.
+    for (auto& func : *module) {
+        if (&func != hot && !func.isDeclaration()) {
+            func.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+        }
+    }
+    for (auto& global : module->globals()) {
+        if (!global.isConstant() && !global.isDeclaration()) {
+            global.setInitializer(nullptr);
+            global.setLinkage(llvm::GlobalValue::ExternalLinkage);
+        }
+    }
+
+    detachDefinition(hot, Tier1Suffix);
+
+    Optimizer::optimizeWithPipeline(module.get(), OptimizationLevel::O3, &targetMachine);
+
+    for (auto& func : *module) {
+        if (func.hasAvailableExternallyLinkage()) {
+            func.deleteBody();
+        }
+    }
+
+    llvm::orc::SimpleCompiler compile(targetMachine, cache);
+    auto object = compile(*module);
+    if (!object) {
+        reportError(object.takeError());
+        return false;
+    }
+
+    if (auto err = jit_->addObjectFile(std::move(*object))) {
+        reportError(std::move(err));
+        return false;
+    }
+
+    auto optimized = jit_->lookup(name + Tier1Suffix);
+    if (!optimized) {
+        reportError(optimized.takeError());
+        return false;
+    }
+
+    if (auto err = stubs_->updatePointer(name, *optimized)) {
+        reportError(std::move(err));
+        return false;
+    }
+
+    return true;
+}
+
+bool JITEngine::addLibrary(const String& path) {
+    if (!jit_) return false;
+
+    auto generator = llvm::orc::DynamicLibrarySearchGenerator::Load(
+        path.c_str(), jit_->getDataLayout().getGlobalPrefix());
+    if (!generator) {
+        reportError(generator.takeError());
+        return false;
+    }
+
+    jit_->getMainJITDylib().addGenerator(std::move(*generator));
+    return true;
 }
 
 void* JITEngine::lookup(const String& name) {
     if (!jit_) return nullptr;
-    
+
     auto symbol = jit_->lookup(name);
     if (!symbol) {
+        reportError(symbol.takeError());
         return nullptr;
     }
-    
+
     return symbol->toPtr<void*>();
 }
 
+int JITEngine::runMain(const String& programName, const Vec<String>& args) {
+    using MainFn = int (*)(int, char*[]);
+
+    auto mainFn = getFunction<MainFn>("main");
+    if (!mainFn) {
+        return 1;
+    }
+
+    return llvm::orc::runAsMain(mainFn, args, llvm::StringRef(programName));
 }
 
+}
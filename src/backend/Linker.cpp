@@ -0,0 +1,302 @@
+#include "backend/Linker.h"
+
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Transforms/IPO/Internalize.h>
+
+#if LLVM_VERSION_MAJOR >= 15
+    #include <llvm/TargetParser/Host.h>
+#else
+    #include <llvm/Support/Host.h>
+#endif
+
+#if LLVM_VERSION_MAJOR >= 16
+    #include <llvm/TargetParser/Triple.h>
+#else
+    #include <llvm/ADT/Triple.h>
+#endif
+
+#ifdef XYPHER_HAVE_LLD
+#include <lld/Common/Driver.h>
+LLD_HAS_DRIVER(elf)
+#endif
+
+#include <mutex>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace xypher {
+
+namespace {
+
+// Adds the functions whose code refers to `value`, looking through constant expressions
+void collectUsers(llvm::Value* value, llvm::SmallPtrSetImpl<llvm::Function*>& functions,
+                  Vec<llvm::Function*>& worklist) {
+    for (llvm::User* user : value->users()) {
+        if (auto* inst = llvm::dyn_cast<llvm::Instruction>(user)) {
+            if (functions.insert(inst->getFunction()).second) {
+                worklist.push_back(inst->getFunction());
+            }
+        } else if (llvm::isa<llvm::ConstantExpr>(user)) {
+            collectUsers(user, functions, worklist);
+        }
+    }
+}
+
+// Turns every function that reads or writes the library's own mutable globals,
+// or calls one that does, into a declaration. Returns false if one of them can't
+// be referenced from outside the library.
+bool dropStatefulFunctions(llvm::Module& library) {
+    llvm::SmallPtrSet<llvm::Function*, 32> stateful;
+    Vec<llvm::Function*> worklist;
+
+    for (auto& global : library.globals()) {
+        if (!global.isDeclaration() && !global.isConstant()) {
+            collectUsers(&global, stateful, worklist);
+        }
+    }
+    while (!worklist.empty()) {
+        llvm::Function* func = worklist.back();
+        worklist.pop_back();
+        collectUsers(func, stateful, worklist);
+    }
+
+    for (llvm::Function* func : stateful) {
+        func->deleteBody();
+    }
+    for (llvm::Function* func : stateful) {
+        if (!func->hasLocalLinkage()) {
+            continue;
+        }
+        // A static helper: its callers are gone too unless it is referenced from data
+        if (!func->use_empty()) {
+            return false;
+        }
+        func->eraseFromParent();
+    }
+    return true;
+}
+
+} // namespace
+
+bool Linker::linkStdLibBitcode(llvm::Module& module, const String& bitcodeFile) {
+    llvm::SMDiagnostic diag;
+    Unique<llvm::Module> library = llvm::parseIRFile(bitcodeFile, diag, module.getContext());
+    if (!library) {
+        std::string message;
+        llvm::raw_string_ostream os(message);
+        diag.print("xypc", os);
+        llvm::errs() << "Warning: Cannot read " << bitcodeFile << ": " << os.str();
+        return false;
+    }
+
+    if (!dropStatefulFunctions(*library)) {
+        llvm::errs() << "Warning: " << bitcodeFile << " can't be linked safely; skipping it\n";
+        return false;
+    }
+
+    // Match the user module so the linker doesn't warn about the built-in target
+    library->setTargetTriple(module.getTargetTriple());
+    library->setDataLayout(module.getDataLayout());
+
+    // Like `llvm-link --only-needed --internalize`
+    bool failed = llvm::Linker::linkModules(
+        module, std::move(library), llvm::Linker::LinkOnlyNeeded,
+        [](llvm::Module& linked, const llvm::StringSet<>& imported) {
+            llvm::internalizeModule(linked, [&imported](const llvm::GlobalValue& value) {
+                return !value.hasName() || !imported.count(value.getName());
+            });
+        });
+    return !failed;
+}
+
+#if defined(XYPHER_HAVE_LLD) && defined(__linux__)
+
+namespace {
+
+const char* const DynamicLinker = "/lib64/ld-linux-x86-64.so.2";
+
+// LLD keeps global state: one link at a time, and none after a link that left it
+// unable to run again (lld::Result::canRunAgain)
+std::mutex lldMutex;
+bool lldReusable = true;
+
+String findFile(const Vec<String>& dirs, const String& name) {
+    for (const auto& dir : dirs) {
+        llvm::SmallString<256> path(dir);
+        llvm::sys::path::append(path, name);
+        if (llvm::sys::fs::exists(path)) {
+            return String(path.str());
+        }
+    }
+    return "";
+}
+
+// Newest /usr/lib/gcc/<triple>/<version> that ships crtbeginS.o, or empty.
+String findGccRuntimeDir(const String& multiarch) {
+    String best;
+    int bestMajor = -1;
+
+    Vec<String> roots = {"/usr/lib/gcc/" + multiarch, "/usr/lib/gcc/x86_64-redhat-linux"};
+    for (const auto& root : roots) {
+        std::error_code ec;
+        for (llvm::sys::fs::directory_iterator it(root, ec), end; !ec && it != end;
+             it.increment(ec)) {
+            String dir = it->path();
+            String version = String(llvm::sys::path::filename(dir));
+            int major = std::atoi(version.c_str());
+            if (major > bestMajor && !findFile({dir}, "crtbeginS.o").empty()) {
+                best = dir;
+                bestMajor = major;
+            }
+        }
+    }
+
+    return best;
+}
+
+// LLD only reads inputs from paths, so in-memory objects are exposed through
+// anonymous memfds rather than being written next to the output.
+class InputFiles {
+public:
+    ~InputFiles() {
+        for (int fd : fds_) {
+            close(fd);
+        }
+    }
+
+    String add(llvm::StringRef buffer) {
+        int fd = memfd_create("xypc-object", MFD_CLOEXEC);
+        if (fd < 0) {
+            return "";
+        }
+        fds_.push_back(fd);
+
+        const char* data = buffer.data();
+        size_t remaining = buffer.size();
+        while (remaining > 0) {
+            ssize_t written = write(fd, data, remaining);
+            if (written <= 0) {
+                return "";
+            }
+            data += written;
+            remaining -= static_cast<size_t>(written);
+        }
+
+        return "/proc/self/fd/" + std::to_string(fd);
+    }
+
+private:
+    Vec<int> fds_;
+};
+
+} // namespace
+
+LinkResult Linker::linkInProcess(const LinkJob& job) {
+    llvm::Triple triple(llvm::sys::getDefaultTargetTriple());
+    if (triple.getArch() != llvm::Triple::x86_64 || !llvm::sys::fs::exists(DynamicLinker)) {
+        return LinkResult::Unavailable;
+    }
+
+    // Without the clang driver we locate the C runtime startup files ourselves
+    String multiarch = "x86_64-linux-gnu";
+    Vec<String> libDirs = {"/usr/lib/" + multiarch, "/lib/" + multiarch, "/usr/lib64", "/lib64",
+                           "/usr/lib"};
+
+    String scrt1 = findFile(libDirs, "Scrt1.o");
+    String crti = findFile(libDirs, "crti.o");
+    String crtn = findFile(libDirs, "crtn.o");
+    if (scrt1.empty() || crti.empty() || crtn.empty()) {
+        return LinkResult::Unavailable;
+    }
+
+    String gccDir = findGccRuntimeDir(multiarch);
+
+    InputFiles inputs;
+    Vec<String> args = {"ld.lld", "--eh-frame-hdr", "-pie",     "-dynamic-linker",
+                        DynamicLinker, "-o",         job.outputFile, scrt1, crti};
+
+    if (!gccDir.empty()) {
+        args.push_back(gccDir + "/crtbeginS.o");
+        args.push_back("-L" + gccDir);
+    }
+    for (const auto& dir : libDirs) {
+        args.push_back("-L" + dir);
+    }
+
+    for (const auto& buffer : job.objectBuffers) {
+        String path = inputs.add(buffer);
+        if (path.empty()) {
+            return LinkResult::Unavailable;
+        }
+        args.push_back(path);
+    }
+    for (const auto& file : job.objectFiles) {
+        args.push_back(file);
+    }
+
+    if (!job.stdLibDir.empty()) {
+        args.push_back("-L" + job.stdLibDir);
+        args.push_back("-lxystd");
+        args.push_back("-rpath");
+        args.push_back(job.stdLibDir);
+    }
+
+    if (job.gcSections) {
+        args.push_back("--gc-sections");
+    }
+    if (job.strip) {
+        args.push_back("-s");
+    }
+
+    args.push_back("-lc");
+    if (!gccDir.empty()) {
+        args.push_back("-lgcc");
+        args.push_back(gccDir + "/crtendS.o");
+    }
+    args.push_back(crtn);
+
+    Vec<const char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(arg.c_str());
+    }
+
+    std::lock_guard<std::mutex> lock(lldMutex);
+    if (!lldReusable) {
+        return LinkResult::Unavailable;
+    }
+
+    lld::Result result =
+        lld::lldMain(argv, llvm::outs(), llvm::errs(), {{lld::Gnu, &lld::elf::link}});
+    if (!result.canRunAgain) {
+        // LLD's global state is left unusable; later links in this process use clang
+        lldReusable = false;
+    }
+    if (result.retCode != 0) {
+        llvm::errs() << "ld.lld failed with exit code " << result.retCode << "\n";
+        return LinkResult::Failure;
+    }
+    return LinkResult::Success;
+}
+
+#else
+
+LinkResult Linker::linkInProcess(const LinkJob& job) {
+    (void)job;
+    return LinkResult::Unavailable;
+}
+
+#endif
+
+} // namespace xypher
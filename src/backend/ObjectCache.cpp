@@ -0,0 +1,121 @@
+#include "backend/ObjectCache.h"
+
+#include "XypherConfig.h"
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/CachePruning.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA256.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace xypher {
+
+namespace {
+
+// Objects share the directory with other caches (e.g. compile/), so they carry the
+// prefix pruneCache looks for and nothing else is ever pruned
+const char* const ObjectPrefix = "llvmcache-";
+
+// Least recently used objects go once the cache outgrows this, or after a week unused
+constexpr uint64_t MaxCacheBytes = 512ull << 20;
+
+// Feeds everything written to it into a SHA-256, so the module's bitcode is
+// hashed as it is produced instead of being buffered first
+class HashingStream : public llvm::raw_ostream {
+public:
+    explicit HashingStream(llvm::SHA256& hasher) : hasher_(hasher) { SetUnbuffered(); }
+
+private:
+    llvm::SHA256& hasher_;
+    uint64_t position_ = 0;
+
+    void write_impl(const char* data, size_t size) override {
+        hasher_.update(llvm::StringRef(data, size));
+        position_ += size;
+    }
+    uint64_t current_pos() const override { return position_; }
+};
+
+} // namespace
+
+PersistentObjectCache::PersistentObjectCache(String directory, String salt)
+    : directory_(std::move(directory)), salt_(std::move(salt)) {
+    llvm::sys::fs::create_directories(directory_);
+
+    // Rate-limited by a timestamp file in the directory, so most runs skip the scan
+    llvm::CachePruningPolicy policy;
+    policy.MaxSizeBytes = MaxCacheBytes;
+    llvm::pruneCache(directory_, policy);
+}
+
+String PersistentObjectCache::defaultDirectory() {
+    llvm::SmallString<256> path;
+    if (!llvm::sys::path::cache_directory(path)) {
+        return "";
+    }
+
+    llvm::sys::path::append(path, "xypher");
+    return String(path.str());
+}
+
+String PersistentObjectCache::computeKey(const llvm::Module* module) const {
+    llvm::SHA256 hasher;
+    hasher.update(salt_);
+    hasher.update("\n" XYPHER_VERSION_STRING "\n" LLVM_VERSION_STRING "\n");
+
+    // Bitcode is much cheaper to produce than textual IR and just as exact
+    HashingStream os(hasher);
+    llvm::WriteBitcodeToFile(*module, os);
+    os.flush();
+
+    return llvm::toHex(hasher.final(), true);
+}
+
+String PersistentObjectCache::getObjectPath(const String& key) const {
+    llvm::SmallString<256> path(directory_);
+    llvm::sys::path::append(path, ObjectPrefix + key + ".o");
+    return String(path.str());
+}
+
+std::unique_ptr<llvm::MemoryBuffer> PersistentObjectCache::getObject(const llvm::Module* module) {
+    String key = computeKey(module);
+
+    auto buffer = llvm::MemoryBuffer::getFile(getObjectPath(key), false, false);
+    if (buffer) {
+        return std::move(*buffer);
+    }
+
+    // The compiler reports the fresh object for the same module right after a miss
+    std::lock_guard<std::mutex> lock(mutex_);
+    pendingKeys_[module] = std::move(key);
+    return nullptr;
+}
+
+void PersistentObjectCache::notifyObjectCompiled(const llvm::Module* module,
+                                                 llvm::MemoryBufferRef object) {
+    String key;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = pendingKeys_.find(module);
+        if (it != pendingKeys_.end()) {
+            key = std::move(it->second);
+            pendingKeys_.erase(it);
+        }
+    }
+
+    if (key.empty()) {
+        key = computeKey(module);
+    }
+
+    // Written to a temporary and renamed, so concurrent runs never see half an object
+    auto err = llvm::writeToOutput(getObjectPath(key), [&](llvm::raw_ostream& os) {
+        os << object.getBuffer();
+        return llvm::Error::success();
+    });
+    llvm::consumeError(std::move(err));
+}
+
+} // namespace xypher
@@ -0,0 +1,126 @@
+#include "backend/OptRemarks.h"
+
+#include <iostream>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/LLVMRemarkStreamer.h>
+#include <llvm/Remarks/RemarkStreamer.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/raw_ostream.h>
+
+namespace xypher {
+
+namespace {
+
+// Mirrors clang's -Rpass handling: a remark is printed when its pass name matches
+// the pattern for its kind. Everything else that isn't a remark keeps LLVM's
+// default handling.
+class RemarkPrinter : public llvm::DiagnosticHandler {
+public:
+    RemarkPrinter(Optional<llvm::Regex> passed, Optional<llvm::Regex> missed)
+        : passed_(std::move(passed)), missed_(std::move(missed)) {}
+
+    bool isPassedOptRemarkEnabled(llvm::StringRef passName) const override {
+        return passed_ && passed_->match(passName);
+    }
+
+    bool isMissedOptRemarkEnabled(llvm::StringRef passName) const override {
+        return missed_ && missed_->match(passName);
+    }
+
+    bool isAnalysisRemarkEnabled(llvm::StringRef) const override {
+        return false;
+    }
+
+    // OptimizationRemarkEmitter asks this before building any remark through a
+    // lambda (the inliner, most of LoopVectorize); the default only looks at
+    // LLVM's own -pass-remarks options, so -Rpass alone would print nothing
+    bool isAnyRemarkEnabled() const override {
+        return passed_.has_value() || missed_.has_value();
+    }
+
+    bool handleDiagnostics(const llvm::DiagnosticInfo& info) override {
+        auto* remark = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&info);
+        if (!remark) {
+            return false;
+        }
+
+        const char* flag = nullptr;
+        if (remark->isPassed() && isPassedOptRemarkEnabled(remark->getPassName())) {
+            flag = "-Rpass";
+        } else if (remark->isMissed() && isMissedOptRemarkEnabled(remark->getPassName())) {
+            flag = "-Rpass-missed";
+        }
+
+        if (flag) {
+            String location = remark->isLocationAvailable()
+                                  ? remark->getLocationStr()
+                                  : remark->getFunction().getName().str();
+            llvm::errs() << location << ": remark: " << remark->getMsg() << " [" << flag << "="
+                         << remark->getPassName() << "]\n";
+        }
+        return true; // Remarks are only ever shown here
+    }
+
+private:
+    Optional<llvm::Regex> passed_;
+    Optional<llvm::Regex> missed_;
+};
+
+bool compilePattern(const String& pattern, const char* flag, Optional<llvm::Regex>& regex) {
+    if (pattern.empty()) {
+        return true;
+    }
+
+    regex.emplace(pattern);
+    std::string error;
+    if (!regex->isValid(error)) {
+        std::cerr << "Error: Invalid regular expression in " << flag << "=" << pattern << ": "
+                  << error << "\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+OptRemarks::OptRemarks(llvm::LLVMContext& context, Unique<llvm::ToolOutputFile> file)
+    : context_(context), file_(std::move(file)) {}
+
+OptRemarks::~OptRemarks() {
+    if (file_) {
+        // The streamers point into file_; the context may outlive us
+        context_.setLLVMRemarkStreamer(nullptr);
+        context_.setMainRemarkStreamer(nullptr);
+        file_->keep();
+    }
+}
+
+Unique<OptRemarks> OptRemarks::enable(llvm::LLVMContext& context, const RemarkOptions& options) {
+    Optional<llvm::Regex> passed;
+    Optional<llvm::Regex> missed;
+    if (!compilePattern(options.passedPattern, "-Rpass", passed) ||
+        !compilePattern(options.missedPattern, "-Rpass-missed", missed)) {
+        return nullptr;
+    }
+
+    if (passed || missed) {
+        context.setDiagnosticHandler(
+            std::make_unique<RemarkPrinter>(std::move(passed), std::move(missed)));
+    }
+
+    Unique<llvm::ToolOutputFile> file;
+    if (!options.file.empty()) {
+        auto stream = llvm::setupLLVMOptimizationRemarks(context, options.file, "", "yaml", false);
+        if (!stream) {
+            std::cerr << "Error: Cannot write optimization remarks to " << options.file << ": "
+                      << llvm::toString(stream.takeError()) << "\n";
+            return nullptr;
+        }
+        file = std::move(*stream);
+    }
+
+    return Unique<OptRemarks>(new OptRemarks(context, std::move(file)));
+}
+
+} // namespace xypher
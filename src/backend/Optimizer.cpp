@@ -1,16 +1,26 @@
 #include "backend/Optimizer.h"
 
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 #include <llvm/Analysis/CGSCCPassManager.h>
+#include <llvm/Analysis/InlineCost.h>
 #include <llvm/Analysis/LoopAnalysisManager.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/VirtualFileSystem.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Transforms/IPO/AlwaysInliner.h>
 #include <llvm/Transforms/IPO/DeadArgumentElimination.h>
 #include <llvm/Transforms/IPO/FunctionAttrs.h>
 #include <llvm/Transforms/IPO/GlobalOpt.h>
+#include <llvm/Transforms/IPO/Inliner.h>
 #include <llvm/Transforms/InstCombine/InstCombine.h>
+#include <llvm/Transforms/Instrumentation/InstrProfiling.h>
+#include <llvm/Transforms/Instrumentation/PGOInstrumentation.h>
 #include <llvm/Transforms/Scalar/ADCE.h>
 #include <llvm/Transforms/Scalar/DCE.h>
 #include <llvm/Transforms/Scalar/EarlyCSE.h>
@@ -29,7 +39,31 @@
 
 namespace xypher {
 
-void Optimizer::optimize(llvm::Module* module, OptimizationLevel level) {
+namespace {
+
+// Same default as clang's -fprofile-generate; %m keeps binaries from clobbering each other
+String profileOutputFile(const ProfileOptions& profile) {
+    return profile.generateFile.empty() ? "default_%m.profraw" : profile.generateFile;
+}
+
+std::optional<llvm::PGOOptions> makePGOOptions(const ProfileOptions& profile) {
+    if (profile.generate) {
+        return llvm::PGOOptions(profileOutputFile(profile), "", "", "",
+                                llvm::vfs::getRealFileSystem(), llvm::PGOOptions::IRInstr);
+    }
+    if (!profile.useFile.empty()) {
+        return llvm::PGOOptions(profile.useFile, "", "", "", llvm::vfs::getRealFileSystem(),
+                                llvm::PGOOptions::IRUse);
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
+void Optimizer::optimize(llvm::Module* module, OptimizationLevel level,
+                         llvm::TargetMachine* targetMachine,
+                         llvm::PassInstrumentationCallbacks* instrumentation,
+                         const ProfileOptions& profile) {
     if (level == OptimizationLevel::None)
         return;
 
@@ -38,7 +72,9 @@ void Optimizer::optimize(llvm::Module* module, OptimizationLevel level) {
     llvm::CGSCCAnalysisManager CGAM;
     llvm::ModuleAnalysisManager MAM;
 
-    llvm::PassBuilder PB;
+    // The default pipeline places the PGO passes itself
+    llvm::PassBuilder PB(targetMachine, llvm::PipelineTuningOptions(), makePGOOptions(profile),
+                         instrumentation);
     PB.registerModuleAnalyses(MAM);
     PB.registerCGSCCAnalyses(CGAM);
     PB.registerFunctionAnalyses(FAM);
@@ -70,7 +106,10 @@ void Optimizer::optimize(llvm::Module* module, OptimizationLevel level) {
     MPM.run(*module, MAM);
 }
 
-void Optimizer::optimizeWithPipeline(llvm::Module* module, OptimizationLevel level) {
+void Optimizer::optimizeWithPipeline(llvm::Module* module, OptimizationLevel level,
+                                     llvm::TargetMachine* targetMachine,
+                                     llvm::PassInstrumentationCallbacks* instrumentation,
+                                     const ProfileOptions& profile) {
     if (level == OptimizationLevel::None)
         return;
 
@@ -84,7 +123,9 @@ void Optimizer::optimizeWithPipeline(llvm::Module* module, OptimizationLevel lev
     llvm::CGSCCAnalysisManager CGAM;
     llvm::ModuleAnalysisManager MAM;
 
-    llvm::PassBuilder PB;
+    // Registers TargetIRAnalysis backed by the target's TTI
+    llvm::PassBuilder PB(targetMachine, llvm::PipelineTuningOptions(), makePGOOptions(profile),
+                         instrumentation);
 
     PB.registerModuleAnalyses(MAM);
     PB.registerCGSCCAnalyses(CGAM);
@@ -109,6 +150,31 @@ void Optimizer::optimizeWithPipeline(llvm::Module* module, OptimizationLevel lev
         }
     }
 
+    // Counters go in (or the profile is matched up) right after the early cleanup:
+    // the CFG is small by then and identical between the two builds, which the
+    // profile's per-function CFG hashes depend on.
+    if (profile.generate || !profile.useFile.empty()) {
+        llvm::ModulePassManager profileMPM;
+        if (profile.generate) {
+            profileMPM.addPass(llvm::PGOInstrumentationGen());
+        } else {
+            profileMPM.addPass(llvm::PGOInstrumentationUse(profile.useFile));
+
+            // Nothing else in this pipeline inlines, so without this the profile only
+            // steers block layout. The inliner reads the annotated counts through
+            // ProfileSummaryAnalysis and raises its threshold for hot call sites.
+            if (level >= OptimizationLevel::O2) {
+                unsigned sizeLevel = level == OptimizationLevel::Os   ? 1
+                                     : level == OptimizationLevel::Oz ? 2
+                                                                      : 0;
+                unsigned speedLevel = level == OptimizationLevel::O3 ? 3 : 2;
+                profileMPM.addPass(
+                    llvm::ModuleInlinerWrapperPass(llvm::getInlineParams(speedLevel, sizeLevel)));
+            }
+        }
+        profileMPM.run(*module, MAM);
+    }
+
     if (level >= OptimizationLevel::O1) {
         midFPM.addPass(llvm::DCEPass());
         midFPM.addPass(llvm::SimplifyCFGPass());
@@ -196,6 +262,14 @@ void Optimizer::optimizeWithPipeline(llvm::Module* module, OptimizationLevel lev
         }
     }
 
+    // Lower the counter intrinsics last, after the passes above have had a chance
+    // to drop the counters of deleted code
+    if (profile.generate) {
+        llvm::InstrProfOptions options;
+        options.InstrProfileOutput = profileOutputFile(profile);
+        MPM.addPass(llvm::InstrProfilingLoweringPass(options, false));
+    }
+
     if (!MPM.isEmpty()) {
         MPM.run(*module, MAM);
     }
@@ -224,8 +298,110 @@ bool Optimizer::verifyModule(llvm::Module* module, bool fatal) {
     return true;
 }
 
-void Optimizer::printOptimizationStats(llvm::Module* module) {
-    (void)module;
+namespace {
+
+bool isVectorInstruction(const llvm::Instruction& inst) {
+    if (inst.getType()->isVectorTy()) {
+        return true;
+    }
+    return std::any_of(inst.op_begin(), inst.op_end(),
+                       [](const llvm::Use& op) { return op->getType()->isVectorTy(); });
+}
+
+void printCount(std::ostream& out, const char* label, size_t before, size_t after) {
+    out << "  " << std::left << std::setw(22) << label << std::right << std::setw(8) << before
+        << " -> " << std::setw(8) << after;
+    if (before != 0 && before != after) {
+        double change = (static_cast<double>(after) - static_cast<double>(before)) * 100.0 /
+                        static_cast<double>(before);
+        out << "  (" << std::showpos << std::fixed << std::setprecision(1) << change << "%"
+            << std::noshowpos << std::defaultfloat << ")";
+    }
+    out << "\n";
+}
+
+} // namespace
+
+ModuleStats Optimizer::collectStats(const llvm::Module& module) {
+    ModuleStats stats;
+    for (const auto& F : module) {
+        if (F.isDeclaration()) {
+            continue;
+        }
+
+        stats.functions++;
+        stats.basicBlocks += F.size();
+
+        size_t size = 0;
+        for (const auto& inst : llvm::instructions(F)) {
+            if (llvm::isa<llvm::DbgInfoIntrinsic>(inst)) {
+                continue;
+            }
+            size++;
+            if (llvm::isa<llvm::CallBase>(inst)) {
+                stats.calls++;
+            } else if (llvm::isa<llvm::AllocaInst>(inst)) {
+                stats.allocas++;
+            } else if (llvm::isa<llvm::LoadInst>(inst)) {
+                stats.loads++;
+            } else if (llvm::isa<llvm::StoreInst>(inst)) {
+                stats.stores++;
+            }
+            if (isVectorInstruction(inst)) {
+                stats.vectorInstructions++;
+            }
+        }
+
+        stats.instructions += size;
+        stats.functionSizes[F.getName().str()] = size;
+    }
+    return stats;
+}
+
+void Optimizer::printOptimizationStats(const ModuleStats& before, llvm::Module* module,
+                                       std::ostream& out) {
+    ModuleStats after = collectStats(*module);
+
+    out << "Optimization statistics: " << module->getModuleIdentifier() << "\n";
+    printCount(out, "functions", before.functions, after.functions);
+    printCount(out, "basic blocks", before.basicBlocks, after.basicBlocks);
+    printCount(out, "instructions", before.instructions, after.instructions);
+    printCount(out, "calls", before.calls, after.calls);
+    printCount(out, "allocas", before.allocas, after.allocas);
+    printCount(out, "loads", before.loads, after.loads);
+    printCount(out, "stores", before.stores, after.stores);
+    printCount(out, "vector instructions", before.vectorInstructions,
+               after.vectorInstructions);
+
+    // Sorted by name so the output diffs cleanly between runs
+    Vec<String> names;
+    for (const auto& [name, size] : before.functionSizes) {
+        names.push_back(name);
+    }
+    for (const auto& [name, size] : after.functionSizes) {
+        if (!before.functionSizes.count(name)) {
+            names.push_back(name);
+        }
+    }
+    std::sort(names.begin(), names.end());
+
+    out << "\n  " << std::left << std::setw(32) << "function" << std::right << std::setw(8)
+        << "before" << std::setw(8) << "after" << std::setw(8) << "delta" << "\n";
+    for (const auto& name : names) {
+        auto oldSize = before.functionSizes.find(name);
+        auto newSize = after.functionSizes.find(name);
+        size_t oldCount = oldSize != before.functionSizes.end() ? oldSize->second : 0;
+
+        out << "  " << std::left << std::setw(32) << name << std::right << std::setw(8)
+            << oldCount;
+        if (newSize == after.functionSizes.end()) {
+            out << std::setw(8) << "-" << "  (removed)\n";
+            continue;
+        }
+        long delta = static_cast<long>(newSize->second) - static_cast<long>(oldCount);
+        out << std::setw(8) << newSize->second << std::setw(8) << std::showpos << delta
+            << std::noshowpos << "\n";
+    }
 }
 
 } // namespace xypher
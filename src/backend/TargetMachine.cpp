@@ -6,6 +6,8 @@
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/Config/llvm-config.h>
 
+#include <mutex>
+
 // Try to include Host header from different locations depending on LLVM version
 #if LLVM_VERSION_MAJOR >= 15
     #include <llvm/TargetParser/Host.h>
@@ -24,18 +26,77 @@ extern "C" {
 
 namespace xypher {
 
+namespace {
+
+String configKey(const TargetConfig& config) {
+    return config.triple + ";" + config.cpu + ";" + config.features + ";" +
+           std::to_string(static_cast<int>(config.codeGenLevel));
+}
+
+std::mutex poolMutex;
+Map<String, Vec<Unique<llvm::TargetMachine>>> idleMachines;
+
+} // namespace
+
 void TargetMachineManager::initialize() {
-    LLVMInitializeX86TargetInfo();
-    LLVMInitializeX86Target();
-    LLVMInitializeX86TargetMC();
-    LLVMInitializeX86AsmParser();
-    LLVMInitializeX86AsmPrinter();
+    static std::once_flag initialized;
+    std::call_once(initialized, [] {
+        LLVMInitializeX86TargetInfo();
+        LLVMInitializeX86Target();
+        LLVMInitializeX86TargetMC();
+        LLVMInitializeX86AsmParser();
+        LLVMInitializeX86AsmPrinter();
+    });
+}
+
+llvm::TargetMachine* TargetMachineManager::getTargetMachine(const TargetConfig& config) {
+    thread_local Map<String, Unique<llvm::TargetMachine>> cache;
+
+    String key = configKey(config);
+
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+        return it->second.get();
+    }
+
+    initialize();
+    auto targetMachine = createTargetMachine(config);
+    if (!targetMachine) {
+        return nullptr;
+    }
+
+    return (cache[key] = std::move(targetMachine)).get();
+}
+
+Unique<llvm::TargetMachine> TargetMachineManager::borrowTargetMachine(const TargetConfig& config) {
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        auto it = idleMachines.find(configKey(config));
+        if (it != idleMachines.end() && !it->second.empty()) {
+            Unique<llvm::TargetMachine> targetMachine = std::move(it->second.back());
+            it->second.pop_back();
+            return targetMachine;
+        }
+    }
+
+    initialize();
+    return createTargetMachine(config);
+}
+
+void TargetMachineManager::returnTargetMachine(const TargetConfig& config,
+                                               Unique<llvm::TargetMachine> targetMachine) {
+    if (!targetMachine) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(poolMutex);
+    idleMachines[configKey(config)].push_back(std::move(targetMachine));
 }
 
-llvm::TargetMachine* TargetMachineManager::createTargetMachine(
+Unique<llvm::TargetMachine> TargetMachineManager::createTargetMachine(
     const String& targetTriple,
     const String& cpu,
-    const String& features) {
+    const String& features,
+    llvm::CodeGenOptLevel codeGenLevel) {
     
     String triple = targetTriple.empty() ? 
                    llvm::sys::getDefaultTargetTriple() : targetTriple;
@@ -49,18 +110,48 @@ llvm::TargetMachine* TargetMachineManager::createTargetMachine(
     
     String cpuStr = cpu.empty() ? "generic" : cpu;
     String featuresStr = features;
+
+    if (cpu == "native") {
+        cpuStr = llvm::sys::getHostCPUName().str();
+        String hostFeatures = getHostFeatures();
+        featuresStr = features.empty() ? hostFeatures : hostFeatures + "," + features;
+    }
     
     llvm::TargetOptions opt;
-    llvm::TargetMachine* targetMachine = target->createTargetMachine(
+    Unique<llvm::TargetMachine> targetMachine(target->createTargetMachine(
         triple,
         cpuStr,
         featuresStr,
         opt,
-        llvm::Reloc::PIC_
-    );
+        llvm::Reloc::PIC_,
+        std::nullopt,
+        codeGenLevel
+    ));
     
     return targetMachine;
 }
 
+Unique<llvm::TargetMachine> TargetMachineManager::createTargetMachine(const TargetConfig& config) {
+    return createTargetMachine(config.triple, config.cpu, config.features, config.codeGenLevel);
+}
+
+String TargetMachineManager::getHostFeatures() {
+#if LLVM_VERSION_MAJOR >= 19
+    llvm::StringMap<bool> hostFeatures = llvm::sys::getHostCPUFeatures();
+#else
+    llvm::StringMap<bool> hostFeatures;
+    llvm::sys::getHostCPUFeatures(hostFeatures);
+#endif
+
+    String result;
+    for (const auto& feature : hostFeatures) {
+        if (!result.empty()) {
+            result += ",";
+        }
+        result += (feature.getValue() ? "+" : "-") + feature.getKey().str();
+    }
+    return result;
+}
+
 } // namespace xypher
 
@@ -0,0 +1,48 @@
+#include "Common.h"
+#include "frontend/CompileServer.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <unistd.h>
+
+using namespace xypher;
+
+// Starts the full compiler with the same arguments, e.g. when no server is listening.
+// It is looked up next to this binary, then on PATH.
+int execCompiler(const char* self, const Vec<String>& args) {
+    String program = self;
+    size_t slash = program.rfind('/');
+    program = slash == String::npos ? "xypc" : program.substr(0, slash + 1) + "xypc";
+
+    Vec<char*> argv;
+    argv.push_back(const_cast<char*>(program.c_str()));
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    execvp(program.c_str(), argv.data());
+    if (program != "xypc") {
+        execvp("xypc", argv.data());
+    }
+    std::cerr << "Error: Cannot start xypc\n";
+    return 1;
+}
+
+// xypc-client: forwards its command line to `xypc --serve`. It links nothing but the
+// socket code, so unlike `xypc --connect` it doesn't load libLLVM or run its static
+// constructors on every invocation.
+int main(int argc, char* argv[]) {
+    Vec<String> args(argv + 1, argv + argc);
+
+    String server = CompileServer::takeServerSocket(args);
+    bool serving = std::find(args.begin(), args.end(), "--serve") != args.end();
+    if (!server.empty() && !serving) {
+        if (auto exitCode = CompileServer::forward(server, args)) {
+            return *exitCode;
+        }
+    }
+
+    return execCompiler(argv[0], args);
+}
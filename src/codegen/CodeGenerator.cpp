@@ -1,18 +1,47 @@
 #include "codegen/CodeGenerator.h"
 
+#include "XypherConfig.h"
 #include "codegen/LLVMBackend.h"
 
+#include <llvm/ADT/SmallString.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/TimeProfiler.h>
 
 namespace xypher {
 
-CodeGenerator::CodeGenerator(const String& moduleName, DiagnosticEngine& diags) : diags_(diags) {
+CodeGenerator::CodeGenerator(const String& moduleName, DiagnosticEngine& diags,
+                             DebugInfoLevel debugInfo, bool optimized)
+    : diags_(diags), sources_(diags.getSourceManager()), debugInfo_(debugInfo),
+      optimized_(optimized) {
     context_ = makeUnique<llvm::LLVMContext>();
     module_ = makeUnique<llvm::Module>(moduleName, *context_);
     builder_ = makeUnique<llvm::IRBuilder<>>(*context_);
+
+    if (debugInfo != DebugInfoLevel::None) {
+        module_->addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                               llvm::DEBUG_METADATA_VERSION);
+        if (debugInfo == DebugInfoLevel::Full) {
+            module_->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+        }
+
+        debugBuilder_ = makeUnique<llvm::DIBuilder>(*module_);
+        // Like clang: the file name as given on the command line, and the working
+        // directory as DW_AT_comp_dir so debuggers can resolve relative names
+        llvm::SmallString<256> compDir;
+        if (llvm::sys::fs::current_path(compDir)) {
+            compDir = llvm::sys::path::parent_path(moduleName);
+        }
+        debugFile_ = debugBuilder_->createFile(moduleName, compDir);
+        debugUnit_ = debugBuilder_->createCompileUnit(
+            llvm::dwarf::DW_LANG_C, debugFile_, "xypc " XYPHER_VERSION_STRING, optimized, "", 0, "",
+            debugInfo == DebugInfoLevel::Full ? llvm::DICompileUnit::FullDebug
+                                              : llvm::DICompileUnit::NoDebug);
+    }
 }
 
 CodeGenerator::~CodeGenerator() = default;
@@ -22,6 +51,10 @@ bool CodeGenerator::generate(Program* program) {
         declareBuiltins();
         program->accept(*this);
 
+        if (debugBuilder_) {
+            debugBuilder_->finalize();
+        }
+
         if (llvm::verifyModule(*module_, &llvm::errs())) {
             error("Module verification failed");
             return false;
@@ -41,8 +74,28 @@ void CodeGenerator::emitLLVMIR(const String& filename) {
     LLVMBackend::emitLLVMIR(module_.get(), filename);
 }
 
-bool CodeGenerator::compileToObject(const String& filename) {
-    return LLVMBackend::emitObject(module_.get(), filename);
+Unique<llvm::Module> CodeGenerator::takeModule() {
+    debugBuilder_.reset();
+    return std::move(module_);
+}
+
+Unique<llvm::LLVMContext> CodeGenerator::takeContext() {
+    builder_.reset();
+    return std::move(context_);
+}
+
+bool CodeGenerator::compileToObject(const String& filename, const TargetConfig& target) {
+    return LLVMBackend::emitObject(module_.get(), filename, target);
+}
+
+bool CodeGenerator::compileToObject(llvm::SmallVectorImpl<char>& buffer,
+                                    const TargetConfig& target) {
+    return LLVMBackend::emitObject(module_.get(), buffer, target);
+}
+
+bool CodeGenerator::compileToObjects(Vec<llvm::SmallVector<char, 0>>& objects, unsigned parts,
+                                     const TargetConfig& target) {
+    return LLVMBackend::emitObjects(module_.get(), parts, objects, target);
 }
 
 llvm::Type* CodeGenerator::getLLVMType(const String& typeName) {
@@ -230,6 +283,93 @@ void CodeGenerator::declareModuleFunctions(const String& moduleName) {
     }
 }
 
+void CodeGenerator::emitLocation(const ASTNode* node) {
+    if (!debugBuilder_ || !currentFunction_ || !currentFunction_->getSubprogram()) {
+        return;
+    }
+
+    LineAndColumn position = sources_.getLineAndColumn(node->getLocation());
+    builder_->SetCurrentDebugLocation(llvm::DILocation::get(
+        *context_, position.line, position.column, currentFunction_->getSubprogram()));
+}
+
+llvm::DISubprogram* CodeGenerator::createDebugFunction(FuncDecl* node, llvm::Function* func) {
+    unsigned line = sources_.getLineAndColumn(node->getLocation()).line;
+
+    // Return type first, then the parameters; null stands for void
+    llvm::SmallVector<llvm::Metadata*, 8> signature;
+    signature.push_back(
+        getDebugType(node->getReturnType() ? node->getReturnType()->getTypeName() : "void"));
+    for (const auto& param : node->getParams()) {
+        signature.push_back(getDebugType(param.type ? param.type->getTypeName() : "i32"));
+    }
+    llvm::DISubroutineType* type =
+        debugBuilder_->createSubroutineType(debugBuilder_->getOrCreateTypeArray(signature));
+
+    llvm::DISubprogram* subprogram = debugBuilder_->createFunction(
+        debugFile_, node->getName(), llvm::StringRef(), debugFile_, line, type, line,
+        llvm::DINode::FlagPrototyped,
+        llvm::DISubprogram::SPFlagDefinition |
+            (optimized_ ? llvm::DISubprogram::SPFlagOptimized : llvm::DISubprogram::SPFlagZero));
+    func->setSubprogram(subprogram);
+    return subprogram;
+}
+
+llvm::DIType* CodeGenerator::getDebugType(const String& typeName) {
+    auto it = debugTypes_.find(typeName);
+    if (it != debugTypes_.end()) {
+        return it->second;
+    }
+
+    // Same mapping as getLLVMType, unknown names included
+    llvm::DIType* type = nullptr;
+    if (typeName == "i8" || typeName == "i16" || typeName == "i32" || typeName == "i64") {
+        type = debugBuilder_->createBasicType(typeName, std::stoul(typeName.substr(1)),
+                                              llvm::dwarf::DW_ATE_signed);
+    } else if (typeName == "u8" || typeName == "u16" || typeName == "u32" || typeName == "u64") {
+        type = debugBuilder_->createBasicType(typeName, std::stoul(typeName.substr(1)),
+                                              llvm::dwarf::DW_ATE_unsigned);
+    } else if (typeName == "f32" || typeName == "f64") {
+        type = debugBuilder_->createBasicType(typeName, std::stoul(typeName.substr(1)),
+                                              llvm::dwarf::DW_ATE_float);
+    } else if (typeName == "bool") {
+        type = debugBuilder_->createBasicType(typeName, 8, llvm::dwarf::DW_ATE_boolean);
+    } else if (typeName == "char") {
+        type = debugBuilder_->createBasicType(typeName, 8, llvm::dwarf::DW_ATE_signed_char);
+    } else if (typeName == "str") {
+        type = debugBuilder_->createPointerType(getDebugType("char"),
+                                                module_->getDataLayout().getPointerSizeInBits(),
+                                                0, std::nullopt, typeName);
+    } else if (typeName != "void") {
+        type = getDebugType("i32");
+    }
+
+    debugTypes_[typeName] = type;
+    return type;
+}
+
+void CodeGenerator::declareDebugVariable(const String& name, const String& typeName,
+                                         llvm::AllocaInst* alloca, const SourceLocation& loc,
+                                         unsigned argNo) {
+    if (debugInfo_ != DebugInfoLevel::Full || !currentFunction_->getSubprogram()) {
+        return;
+    }
+
+    llvm::DISubprogram* scope = currentFunction_->getSubprogram();
+    LineAndColumn position = sources_.getLineAndColumn(loc);
+    unsigned line = position.line;
+    llvm::DILocalVariable* variable =
+        argNo > 0 ? debugBuilder_->createParameterVariable(scope, name, argNo, debugFile_, line,
+                                                           getDebugType(typeName), true)
+                  : debugBuilder_->createAutoVariable(scope, name, debugFile_, line,
+                                                      getDebugType(typeName), true);
+
+    debugBuilder_->insertDeclare(
+        alloca, variable, debugBuilder_->createExpression(),
+        llvm::DILocation::get(*context_, line, position.column, scope),
+        builder_->GetInsertBlock());
+}
+
 void CodeGenerator::error(const String& message) {
     diags_.error(message, SourceLocation());
 }
@@ -256,6 +396,8 @@ void CodeGenerator::visit(BoolLiteral* node) {
 }
 
 void CodeGenerator::visit(Identifier* node) {
+    emitLocation(node);
+
     // Look for local variables first (function scope)
     auto localIt = namedValues_.find(node->getName());
     if (localIt != namedValues_.end()) {
@@ -288,6 +430,8 @@ void CodeGenerator::visit(BinaryExpr* node) {
         return;
     }
 
+    emitLocation(node);
+
     switch (node->getOp()) {
     case TokenType::Plus:
         if (left->getType()->isIntegerTy()) {
@@ -437,6 +581,8 @@ void CodeGenerator::visit(UnaryExpr* node) {
         return;
     }
 
+    emitLocation(node);
+
     switch (node->getOp()) {
     case TokenType::Minus:
         if (operand->getType()->isIntegerTy()) {
@@ -501,6 +647,8 @@ void CodeGenerator::visit(CallExpr* node) {
         }
     }
 
+    emitLocation(node);
+
     // Don't give name to void function calls
     if (func->getReturnType()->isVoidTy()) {
         builder_->CreateCall(func, args);
@@ -515,6 +663,7 @@ void CodeGenerator::visit(TypeName* node) {
 }
 
 void CodeGenerator::visit(ExprStmt* node) {
+    emitLocation(node);
     node->getExpr()->accept(*this);
 }
 
@@ -540,6 +689,12 @@ void CodeGenerator::visit(VarDecl* node) {
 
         globalValues_[node->getName()] = globalVar;
 
+        if (debugInfo_ == DebugInfoLevel::Full) {
+            globalVar->addDebugInfo(debugBuilder_->createGlobalVariableExpression(
+                debugUnit_, node->getName(), node->getName(), debugFile_,
+                sources_.getLineAndColumn(node->getLocation()).line, getDebugType(typeName), true));
+        }
+
         return;
     }
 
@@ -547,10 +702,12 @@ void CodeGenerator::visit(VarDecl* node) {
     llvm::Type* type = getLLVMType(typeName);
 
     llvm::AllocaInst* alloca = createEntryBlockAlloca(currentFunction_, node->getName(), type);
+    declareDebugVariable(node->getName(), typeName, alloca, node->getLocation());
 
     if (node->getInit()) {
         node->getInit()->accept(*this);
         if (currentValue_) {
+            emitLocation(node);
             builder_->CreateStore(currentValue_, alloca);
         }
     }
@@ -565,8 +722,10 @@ void CodeGenerator::visit(BlockStmt* node) {
 }
 
 void CodeGenerator::visit(ReturnStmt* node) {
+    emitLocation(node);
     if (node->getValue()) {
         node->getValue()->accept(*this);
+        emitLocation(node);
         builder_->CreateRet(currentValue_);
     } else {
         builder_->CreateRetVoid();
@@ -574,12 +733,14 @@ void CodeGenerator::visit(ReturnStmt* node) {
 }
 
 void CodeGenerator::visit(IfStmt* node) {
+    emitLocation(node);
     node->getCond()->accept(*this);
     llvm::Value* condValue = currentValue_;
 
     if (!condValue)
         return;
 
+    emitLocation(node);
     condValue = builder_->CreateICmpNE(condValue, llvm::ConstantInt::get(condValue->getType(), 0),
                                        "ifcond");
 
@@ -623,6 +784,8 @@ void CodeGenerator::visit(LoopwhileStmt* node) {
     llvm::BasicBlock* loopBB = llvm::BasicBlock::Create(*context_, "loop");
     llvm::BasicBlock* afterBB = llvm::BasicBlock::Create(*context_, "afterloop");
 
+    // Loop remarks ("loop not vectorized") are reported at the loop's first branch
+    emitLocation(node);
     builder_->CreateBr(condBB);
     builder_->SetInsertPoint(condBB);
 
@@ -630,6 +793,7 @@ void CodeGenerator::visit(LoopwhileStmt* node) {
     llvm::Value* condValue = currentValue_;
 
     if (condValue) {
+        emitLocation(node);
         condValue = builder_->CreateICmpNE(
             condValue, llvm::ConstantInt::get(condValue->getType(), 0), "loopcond");
         builder_->CreateCondBr(condValue, loopBB, afterBB);
@@ -641,6 +805,7 @@ void CodeGenerator::visit(LoopwhileStmt* node) {
     node->getBody()->accept(*this);
 
     if (!builder_->GetInsertBlock()->getTerminator()) {
+        emitLocation(node);
         builder_->CreateBr(condBB);
     }
 
@@ -659,6 +824,7 @@ void CodeGenerator::visit(SayStmt* node) {
     for (size_t i = 0; i < node->getExprs().size(); i++) {
         const auto& expr = node->getExprs()[i];
         expr->accept(*this);
+        emitLocation(node);
 
         if (!currentValue_)
             continue;
@@ -703,6 +869,7 @@ void CodeGenerator::visit(SayStmt* node) {
 void CodeGenerator::visit(TraceStmt* node) {
     // Similar to say, but could include type information
     node->getExpr()->accept(*this);
+    emitLocation(node);
 
     if (!currentValue_)
         return;
@@ -725,6 +892,8 @@ void CodeGenerator::visit(TraceStmt* node) {
 }
 
 void CodeGenerator::visit(FuncDecl* node) {
+    llvm::TimeTraceScope timeScope("CodeGenFunction", [&] { return node->getName(); });
+
     try {
         String returnTypeName =
             node->getReturnType() ? node->getReturnType()->getTypeName() : "void";
@@ -749,16 +918,26 @@ void CodeGenerator::visit(FuncDecl* node) {
             idx++;
         }
 
+        llvm::DISubprogram* subprogram = nullptr;
+        if (debugBuilder_) {
+            subprogram = createDebugFunction(node, func);
+        }
+
         llvm::BasicBlock* bb = llvm::BasicBlock::Create(*context_, "entry", func);
         builder_->SetInsertPoint(bb);
 
         currentFunction_ = func;
         namedValues_.clear();
+        builder_->SetCurrentDebugLocation(llvm::DebugLoc()); // Don't leak the previous function's
+        emitLocation(node);
 
         idx = 0;
         for (auto& arg : func->args()) {
             llvm::AllocaInst* alloca =
                 createEntryBlockAlloca(func, String(arg.getName()), arg.getType());
+            const auto& param = node->getParams()[idx];
+            declareDebugVariable(param.name, param.type ? param.type->getTypeName() : "i32",
+                                 alloca, param.location, static_cast<unsigned>(idx + 1));
             builder_->CreateStore(&arg, alloca);
             namedValues_[String(arg.getName())] = alloca;
             idx++;
@@ -776,6 +955,10 @@ void CodeGenerator::visit(FuncDecl* node) {
             }
         }
 
+        if (subprogram) {
+            debugBuilder_->finalizeSubprogram(subprogram);
+        }
+
         if (llvm::verifyFunction(*func, &llvm::errs())) {
             error("Function verification failed: " + node->getName());
             func->eraseFromParent();
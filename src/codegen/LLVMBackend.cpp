@@ -1,14 +1,23 @@
 #include "codegen/LLVMBackend.h"
 #include "backend/TargetMachine.h"
 
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/MC/TargetRegistry.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
 
+#include <algorithm>
+#include <atomic>
 #include <system_error>
+#include <thread>
 
 namespace xypher {
 
@@ -26,10 +35,9 @@ bool LLVMBackend::emitLLVMIR(llvm::Module* module, const String& filename) {
     return true;
 }
 
-bool LLVMBackend::emitAssembly(llvm::Module* module, const String& filename) {
-    TargetMachineManager::initialize();
-    
-    auto* targetMachine = TargetMachineManager::createTargetMachine();
+bool LLVMBackend::emitAssembly(llvm::Module* module, const String& filename,
+                               const TargetConfig& target) {
+    auto* targetMachine = TargetMachineManager::getTargetMachine(target);
     if (!targetMachine) {
         return false;
     }
@@ -54,16 +62,8 @@ bool LLVMBackend::emitAssembly(llvm::Module* module, const String& filename) {
     return true;
 }
 
-bool LLVMBackend::emitObject(llvm::Module* module, const String& filename) {
-    TargetMachineManager::initialize();
-    
-    auto* targetMachine = TargetMachineManager::createTargetMachine();
-    if (!targetMachine) {
-        return false;
-    }
-    
-    module->setDataLayout(targetMachine->createDataLayout());
-    
+bool LLVMBackend::emitObject(llvm::Module* module, const String& filename,
+                             const TargetConfig& target) {
     std::error_code ec;
     llvm::raw_fd_ostream dest(filename, ec, llvm::sys::fs::OF_None);
     
@@ -71,8 +71,31 @@ bool LLVMBackend::emitObject(llvm::Module* module, const String& filename) {
         return false;
     }
     
+    return emitObject(module, dest, target);
+}
+
+bool LLVMBackend::emitObject(llvm::Module* module, llvm::SmallVectorImpl<char>& buffer,
+                             const TargetConfig& target) {
+    llvm::raw_svector_ostream dest(buffer);
+    return emitObject(module, dest, target);
+}
+
+bool LLVMBackend::emitObject(llvm::Module* module, llvm::raw_pwrite_stream& dest,
+                             const TargetConfig& target) {
+    auto* targetMachine = TargetMachineManager::getTargetMachine(target);
+    if (!targetMachine) {
+        return false;
+    }
+    
+    return emitObject(module, dest, *targetMachine);
+}
+
+bool LLVMBackend::emitObject(llvm::Module* module, llvm::raw_pwrite_stream& dest,
+                             llvm::TargetMachine& targetMachine) {
+    module->setDataLayout(targetMachine.createDataLayout());
+    
     llvm::legacy::PassManager pass;
-    if (targetMachine->addPassesToEmitFile(pass, dest, nullptr,
+    if (targetMachine.addPassesToEmitFile(pass, dest, nullptr,
                                           llvm::CodeGenFileType::ObjectFile)) {
         return false;
     }
@@ -83,6 +106,97 @@ bool LLVMBackend::emitObject(llvm::Module* module, const String& filename) {
     return true;
 }
 
+bool LLVMBackend::emitObjects(llvm::Module* module, unsigned parts,
+                              Vec<llvm::SmallVector<char, 0>>& objects,
+                              const TargetConfig& target) {
+    if (parts <= 1) {
+        objects.emplace_back();
+        return emitObject(module, objects.back(), target);
+    }
+
+    // The pieces share the module's LLVMContext, which can't be used from several
+    // threads, so each one travels to its codegen thread as bitcode. Locals are
+    // preserved rather than promoted: promoted names (and the __llvmsplit_unnamed
+    // names given to string literals) are the same in every input file, so the
+    // objects of a multi-file build would clash at link time.
+    Vec<llvm::SmallVector<char, 0>> pieces;
+    llvm::SplitModule(*module, parts, [&](Unique<llvm::Module> piece) {
+        bool hasDefinitions = false;
+        for (const auto& global : piece->global_values()) {
+            hasDefinitions |= !global.isDeclaration();
+        }
+        if (!hasDefinitions) {
+            return;
+        }
+
+        pieces.emplace_back();
+        llvm::raw_svector_ostream stream(pieces.back());
+        llvm::WriteBitcodeToFile(*piece, stream);
+    }, /*PreserveLocals=*/true);
+
+    size_t first = objects.size();
+    objects.resize(first + pieces.size());
+
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    auto work = [&](llvm::TargetMachine& targetMachine) {
+        for (size_t i = next++; i < pieces.size(); i = next++) {
+            llvm::LLVMContext context;
+            auto piece = llvm::parseBitcodeFile(
+                llvm::MemoryBufferRef(llvm::StringRef(pieces[i].data(), pieces[i].size()),
+                                      module->getModuleIdentifier()),
+                context);
+            if (!piece) {
+                llvm::consumeError(piece.takeError());
+                failed = true;
+                continue;
+            }
+            llvm::raw_svector_ostream dest(objects[first + i]);
+            if (!emitObject(piece->get(), dest, targetMachine)) {
+                failed = true;
+            }
+        }
+    };
+
+    // The time profiler is per thread; helpers join the trace of the calling thread
+    llvm::TimeTraceProfiler* profiler = llvm::getTimeTraceProfilerInstance();
+
+    // One piece per thread at most, and no more threads than the machine can run
+    size_t threadCount = std::min<size_t>(parts, pieces.size());
+    threadCount = std::min<size_t>(threadCount, std::max(1u, std::thread::hardware_concurrency()));
+
+    Vec<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back([&, profiler] {
+            if (profiler) {
+                llvm::timeTraceProfilerInitialize(0, "xypc codegen");
+            }
+            // Helpers only live for this call, so their machines come from the pool
+            Unique<llvm::TargetMachine> targetMachine =
+                TargetMachineManager::borrowTargetMachine(target);
+            if (targetMachine) {
+                work(*targetMachine);
+            } else {
+                failed = true;
+            }
+            TargetMachineManager::returnTargetMachine(target, std::move(targetMachine));
+            if (profiler) {
+                llvm::timeTraceProfilerFinishThread();
+            }
+        });
+    }
+    if (auto* targetMachine = TargetMachineManager::getTargetMachine(target)) {
+        work(*targetMachine);
+    } else {
+        failed = true;
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return !failed;
+}
+
 bool LLVMBackend::optimize(llvm::Module* module, int optLevel) {
     // Suppress unused parameter warnings
     (void)module;
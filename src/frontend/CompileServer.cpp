@@ -0,0 +1,352 @@
+#include "frontend/CompileServer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace xypher {
+
+String CompileServer::takeServerSocket(Vec<String>& args) {
+    for (size_t i = 0; i + 1 < args.size(); i++) {
+        if (args[i] == "--connect") {
+            String socket = args[i + 1];
+            args.erase(args.begin() + i, args.begin() + i + 2);
+            return socket;
+        }
+    }
+
+    const char* env = std::getenv("XYPC_SERVER");
+    return env ? env : "";
+}
+
+#ifndef _WIN32
+
+namespace {
+
+// Wire format. Request: [u32 count] followed by `count` strings, each [u32 length]
+// [bytes]; the first string is the client's working directory, the rest its
+// arguments. The client's stdin/stdout/stderr travel as SCM_RIGHTS alongside the
+// count. Response: [i32 exit code].
+constexpr int ForwardedFds = 3;
+constexpr uint32_t MaxStrings = 1 << 16;
+constexpr uint32_t MaxStringLength = 1 << 20;
+
+char socketToRemove[sizeof(sockaddr_un::sun_path)];
+
+bool writeAll(int fd, const void* data, size_t size) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool readAll(int fd, void* data, size_t size) {
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t got = read(fd, bytes, size);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        bytes += got;
+        size -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+bool writeString(int fd, const String& str) {
+    uint32_t length = static_cast<uint32_t>(str.size());
+    return writeAll(fd, &length, sizeof(length)) && writeAll(fd, str.data(), str.size());
+}
+
+bool readString(int fd, String& str) {
+    uint32_t length;
+    if (!readAll(fd, &length, sizeof(length)) || length > MaxStringLength) {
+        return false;
+    }
+    str.resize(length);
+    return readAll(fd, str.data(), length);
+}
+
+bool makeAddress(const String& path, sockaddr_un& addr) {
+    std::memset(&addr, 0, sizeof(addr));
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+int connectTo(const sockaddr_un& addr) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// The server chdirs and writes files on a client's behalf, so it only serves its own user
+bool peerIsSameUser(int conn) {
+#ifdef __linux__
+    ucred cred{};
+    socklen_t length = sizeof(cred);
+    return getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &length) == 0 &&
+           cred.uid == getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return getpeereid(conn, &uid, &gid) == 0 && uid == getuid();
+#endif
+}
+
+void removeSocketAndExit(int signal) {
+    unlink(socketToRemove);
+    _exit(128 + signal);
+}
+
+bool sendHeader(int fd, uint32_t count) {
+    int fds[ForwardedFds] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+
+    iovec iov{&count, sizeof(count)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+    std::memset(control, 0, sizeof(control));
+
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(fd, &msg, 0);
+    } while (sent < 0 && errno == EINTR);
+    return sent == static_cast<ssize_t>(sizeof(count));
+}
+
+bool receiveHeader(int fd, uint32_t& count, int (&fds)[ForwardedFds]) {
+    iovec iov{&count, sizeof(count)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t got;
+    do {
+        got = recvmsg(fd, &msg, 0);
+    } while (got < 0 && errno == EINTR);
+    if (got != static_cast<ssize_t>(sizeof(count))) {
+        return false;
+    }
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+        return false;
+    }
+    std::memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+    return true;
+}
+
+// Runs in the forked child: takes over the client's cwd and stdio, then compiles
+bool handleRequest(int conn, const CompileServer::CompileFunction& compile) {
+    uint32_t count;
+    int fds[ForwardedFds];
+    if (!receiveHeader(conn, count, fds) || count == 0 || count > MaxStrings) {
+        return false;
+    }
+
+    String cwd;
+    if (!readString(conn, cwd)) {
+        return false;
+    }
+
+    Vec<String> args(count - 1);
+    for (auto& arg : args) {
+        if (!readString(conn, arg)) {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < ForwardedFds; i++) {
+        dup2(fds[i], i);
+        if (fds[i] >= ForwardedFds) {
+            close(fds[i]);
+        }
+    }
+
+    int32_t exitCode = 1;
+    if (chdir(cwd.c_str()) != 0) {
+        std::cerr << "Error: Cannot enter directory: " << cwd << "\n";
+    } else {
+        exitCode = compile(args);
+    }
+
+    std::cout.flush();
+    std::cerr.flush();
+    std::fflush(nullptr);
+
+    return writeAll(conn, &exitCode, sizeof(exitCode));
+}
+
+} // namespace
+
+int CompileServer::serve(const String& socketPath, const CompileFunction& compile) {
+    sockaddr_un addr;
+    if (!makeAddress(socketPath, addr)) {
+        std::cerr << "Error: Invalid socket path: " << socketPath << "\n";
+        return 1;
+    }
+
+    int probe = connectTo(addr);
+    if (probe >= 0) {
+        close(probe);
+        std::cerr << "Error: A server is already listening on " << socketPath << "\n";
+        return 1;
+    }
+    unlink(socketPath.c_str()); // Left behind by a server that didn't shut down cleanly
+
+    // Created owner-only, so other users can't even connect
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    mode_t oldMask = umask(0077);
+    bool bound =
+        listenFd >= 0 && bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    umask(oldMask);
+    if (!bound || listen(listenFd, SOMAXCONN) != 0) {
+        std::cerr << "Error: Cannot listen on " << socketPath << ": " << std::strerror(errno)
+                  << "\n";
+        return 1;
+    }
+
+    std::memcpy(socketToRemove, addr.sun_path, sizeof(socketToRemove));
+    std::signal(SIGINT, removeSocketAndExit);
+    std::signal(SIGTERM, removeSocketAndExit);
+    std::signal(SIGCHLD, SIG_IGN); // Children are reaped automatically
+    std::signal(SIGPIPE, SIG_IGN); // A client may hang up before its reply
+
+    std::cout << "Serving on " << socketPath << std::endl;
+
+    while (true) {
+        int conn = accept(listenFd, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            std::cerr << "Error: accept failed: " << std::strerror(errno) << "\n";
+            unlink(socketToRemove);
+            return 1;
+        }
+
+        if (!peerIsSameUser(conn)) {
+            std::cerr << "Error: Rejected a request from another user\n";
+            close(conn);
+            continue;
+        }
+
+        std::cout.flush();
+        std::cerr.flush();
+
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listenFd);
+            // The request may run `clang` through system(), which needs to reap it
+            std::signal(SIGCHLD, SIG_DFL);
+            std::signal(SIGINT, SIG_DFL);
+            std::signal(SIGTERM, SIG_DFL);
+            _exit(handleRequest(conn, compile) ? 0 : 1);
+        }
+
+        if (pid < 0) {
+            std::cerr << "Error: fork failed: " << std::strerror(errno) << "\n";
+        }
+        close(conn);
+    }
+}
+
+Optional<int> CompileServer::forward(const String& socketPath, const Vec<String>& args) {
+    sockaddr_un addr;
+    if (!makeAddress(socketPath, addr)) {
+        return std::nullopt;
+    }
+
+    int fd = connectTo(addr);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+
+    std::signal(SIGPIPE, SIG_IGN);
+
+    std::error_code ec;
+    String cwd = std::filesystem::current_path(ec).string();
+
+    bool ok = !ec && sendHeader(fd, static_cast<uint32_t>(args.size() + 1)) &&
+              writeString(fd, cwd);
+    for (size_t i = 0; ok && i < args.size(); i++) {
+        ok = writeString(fd, args[i]);
+    }
+
+    int32_t exitCode = 1;
+    ok = ok && readAll(fd, &exitCode, sizeof(exitCode));
+    close(fd);
+
+    if (!ok) {
+        std::cerr << "Error: Compile server at " << socketPath << " dropped the request\n";
+        return 1;
+    }
+    return exitCode;
+}
+
+#else
+
+int CompileServer::serve(const String& socketPath, const CompileFunction& compile) {
+    (void)socketPath;
+    (void)compile;
+    std::cerr << "Error: --serve is not supported on Windows\n";
+    return 1;
+}
+
+Optional<int> CompileServer::forward(const String& socketPath, const Vec<String>& args) {
+    (void)socketPath;
+    (void)args;
+    return std::nullopt;
+}
+
+#endif
+
+} // namespace xypher
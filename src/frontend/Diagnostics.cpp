@@ -3,7 +3,7 @@
 
 namespace xypher {
 
-String Diagnostic::format() const {
+String Diagnostic::format(const SourceManager& sources) const {
     String levelStr;
     switch (level_) {
         case DiagnosticLevel::Note:    levelStr = "note"; break;
@@ -12,7 +12,7 @@ String Diagnostic::format() const {
         case DiagnosticLevel::Fatal:   levelStr = "fatal error"; break;
     }
     
-    String result = location_.toString() + ": " + levelStr + ": " + message_;
+    String result = sources.format(location_) + ": " + levelStr + ": " + message_;
     
     for (const auto& suggestion : suggestions_) {
         result += "\n  suggestion: " + suggestion;
@@ -25,7 +25,8 @@ void DiagnosticEngine::report(DiagnosticLevel level, const String& message, Sour
     Diagnostic diag(level, message, loc);
     diagnostics_.push_back(diag);
     
-    std::cerr << diag.format() << "\n";
+    // One write per diagnostic, so files compiled in parallel don't interleave lines
+    std::cerr << diag.format(sources_) + "\n";
     
     if (level == DiagnosticLevel::Warning) {
         warningCount_++;
@@ -0,0 +1,57 @@
+#include "frontend/SourceManager.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace xypher {
+
+FileId SourceManager::addFile(String filename, StringView text) {
+    files_.push_back({std::move(filename), text, {}});
+    return static_cast<FileId>(files_.size());
+}
+
+const SourceManager::FileEntry* SourceManager::getEntry(FileId file) const {
+    return file != 0 && file <= files_.size() ? &files_[file - 1] : nullptr;
+}
+
+const String& SourceManager::getFilename(FileId file) const {
+    static const String unknown = "<unknown>";
+    const FileEntry* entry = getEntry(file);
+    return entry ? entry->filename : unknown;
+}
+
+StringView SourceManager::getText(FileId file) const {
+    const FileEntry* entry = getEntry(file);
+    return entry ? entry->text : StringView();
+}
+
+LineAndColumn SourceManager::getLineAndColumn(const SourceLocation& loc) const {
+    const FileEntry* entry = getEntry(loc.getFileId());
+    if (!entry) {
+        return {};
+    }
+
+    if (entry->lineStarts.empty()) {
+        const char* begin = entry->text.data();
+        const char* end = begin + entry->text.size();
+        const char* p = begin;
+        entry->lineStarts.push_back(0);
+        while ((p = static_cast<const char*>(std::memchr(p, '\n', end - p)))) {
+            entry->lineStarts.push_back(static_cast<uint32_t>(++p - begin));
+        }
+    }
+
+    // The last line starting at or before the offset
+    auto next = std::upper_bound(entry->lineStarts.begin(), entry->lineStarts.end(),
+                                 loc.getOffset());
+    uint32_t line = static_cast<uint32_t>(next - entry->lineStarts.begin());
+    return {line, loc.getOffset() - *(next - 1) + 1};
+}
+
+String SourceManager::format(const SourceLocation& loc) const {
+    LineAndColumn position = getLineAndColumn(loc);
+    return getFilename(loc.getFileId()) + ":" + std::to_string(position.line) + ":" +
+           std::to_string(position.column);
+}
+
+} // namespace xypher
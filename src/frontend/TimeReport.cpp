@@ -0,0 +1,148 @@
+#include "frontend/TimeReport.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <ctime>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace xypher {
+
+namespace {
+
+#ifndef _WIN32
+double toSeconds(const timeval& tv) {
+    return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+}
+#endif
+
+PhaseTimes threadCPUTime() {
+    PhaseTimes times;
+#ifdef _WIN32
+    times.user = static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#else
+#ifdef RUSAGE_THREAD
+    int who = RUSAGE_THREAD;
+#else
+    int who = RUSAGE_SELF; // No per-thread usage (macOS): includes other threads
+#endif
+    rusage usage;
+    if (getrusage(who, &usage) == 0) {
+        times.user = toSeconds(usage.ru_utime);
+        times.system = toSeconds(usage.ru_stime);
+    }
+#endif
+    return times;
+}
+
+size_t peakResidentBytes() {
+#ifdef _WIN32
+    return 0;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss); // Bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024; // KiB elsewhere
+#endif
+#endif
+}
+
+} // namespace
+
+const char* compilePhaseName(CompilePhase phase) {
+    switch (phase) {
+    case CompilePhase::Read:     return "read";
+    case CompilePhase::Lex:      return "lex";
+    case CompilePhase::Parse:    return "parse";
+    case CompilePhase::Sema:     return "sema";
+    case CompilePhase::CodeGen:  return "codegen";
+    case CompilePhase::Optimize: return "optimize";
+    case CompilePhase::Emit:     return "emit object";
+    case CompilePhase::Link:     return "link";
+    }
+    return "unknown";
+}
+
+PhaseTimes& PhaseTimes::operator+=(const PhaseTimes& other) {
+    wall += other.wall;
+    user += other.user;
+    system += other.system;
+    return *this;
+}
+
+PhaseTimes PhaseTimes::operator*(double factor) const {
+    PhaseTimes scaled;
+    scaled.wall = wall * factor;
+    scaled.user = user * factor;
+    scaled.system = system * factor;
+    return scaled;
+}
+
+Stopwatch::Stopwatch() : wallStart_(std::chrono::steady_clock::now()), cpuStart_(threadCPUTime()) {}
+
+PhaseTimes Stopwatch::elapsed() const {
+    PhaseTimes cpuNow = threadCPUTime();
+
+    PhaseTimes times;
+    times.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart_).count();
+    times.user = cpuNow.user - cpuStart_.user;
+    times.system = cpuNow.system - cpuStart_.system;
+    return times;
+}
+
+void TimeReport::add(CompilePhase phase, const PhaseTimes& times) {
+    size_t rss = peakResidentBytes();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t index = static_cast<size_t>(phase);
+    phases_[index] += times;
+    peakRSS_[index] = std::max(peakRSS_[index], rss);
+}
+
+void TimeReport::addPassTimings(const String& report) {
+    if (report.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    passTimings_.push_back(report);
+}
+
+void TimeReport::print(std::ostream& os) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto row = [&](const char* name, const PhaseTimes& times, size_t rss) {
+        char line[128];
+        std::snprintf(line, sizeof(line), "  %-12s %10.4f %10.4f %10.4f %10.1f\n", name, times.wall,
+                      times.user, times.system, static_cast<double>(rss) / (1024.0 * 1024.0));
+        os << line;
+    };
+
+    os << "===" << String(67, '-') << "===\n";
+    os << "                       xypc compilation time report\n";
+    os << "===" << String(67, '-') << "===\n";
+    os << "  Phase          Wall (s)   User (s) System (s)  Peak RSS (MiB)\n";
+
+    PhaseTimes total;
+    size_t peak = 0;
+    for (size_t i = 0; i < CompilePhaseCount; i++) {
+        row(compilePhaseName(static_cast<CompilePhase>(i)), phases_[i], peakRSS_[i]);
+        total += phases_[i];
+        peak = std::max(peak, peakRSS_[i]);
+    }
+    row("total", total, peak);
+    os << "\n";
+
+    for (const auto& report : passTimings_) {
+        os << report;
+    }
+}
+
+} // namespace xypher
@@ -1,66 +1,205 @@
 #include "lexer/Lexer.h"
 
+#include <bit>
 #include <cctype>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define XYPHER_LEXER_SIMD 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XYPHER_LEXER_SIMD 1
+#endif
 
 namespace xypher {
 
-Lexer::Lexer(String source, String filename)
-    : source_(std::move(source)), filename_(std::move(filename)) {
-    initKeywords();
+namespace {
+
+struct Keyword {
+    StringView text;
+    TokenType type;
+};
+
+constexpr Keyword Keywords[] = {
+    {"func", TokenType::KwFunc},
+    {"return", TokenType::KwReturn},
+    {"if", TokenType::KwIf},
+    {"else", TokenType::KwElse},
+    {"loopwhile", TokenType::KwLoopwhile},
+    {"break", TokenType::KwBreak},
+    {"continue", TokenType::KwContinue},
+    {"say", TokenType::KwSay},
+    {"grab", TokenType::KwGrab},
+    {"link", TokenType::KwLink},
+    {"fall", TokenType::KwFall},
+    {"own", TokenType::KwOwn},
+    {"trace", TokenType::KwTrace},
+    {"let", TokenType::KwLet},
+    {"const", TokenType::KwConst},
+    {"type", TokenType::KwType},
+    {"struct", TokenType::KwStruct},
+    {"enum", TokenType::KwEnum},
+    {"impl", TokenType::KwImpl},
+    {"trait", TokenType::KwTrait},
+    {"for", TokenType::KwFor},
+    {"in", TokenType::KwIn},
+    {"while", TokenType::KwWhile},
+    {"match", TokenType::KwMatch},
+    {"import", TokenType::KwImport},
+    {"from", TokenType::KwFrom},
+    {"async", TokenType::KwAsync},
+    {"await", TokenType::KwAwait},
+    {"spawn", TokenType::KwSpawn},
+    {"true", TokenType::KwTrue},
+    {"false", TokenType::KwFalse},
+    {"null", TokenType::KwNull},
+    {"as", TokenType::KwAs},
+    {"is", TokenType::KwIs},
+
+    {"i8", TokenType::KwI8},
+    {"i16", TokenType::KwI16},
+    {"i32", TokenType::KwI32},
+    {"i64", TokenType::KwI64},
+    {"u8", TokenType::KwU8},
+    {"u16", TokenType::KwU16},
+    {"u32", TokenType::KwU32},
+    {"u64", TokenType::KwU64},
+    {"f32", TokenType::KwF32},
+    {"f64", TokenType::KwF64},
+    {"bool", TokenType::KwBool},
+    {"char", TokenType::KwChar},
+    {"str", TokenType::KwStr},
+    {"void", TokenType::KwVoid},
+};
+
+constexpr size_t MinKeywordLength = 2;
+constexpr size_t MaxKeywordLength = 9;
+constexpr size_t KeywordSlots = 128;
+
+// Perfect over Keywords: every keyword lands in its own slot (checked below), so
+// an identifier is a keyword iff it equals the one keyword in its slot
+constexpr size_t keywordHash(StringView text) {
+    size_t first = static_cast<unsigned char>(text[0]);
+    size_t second = static_cast<unsigned char>(text[1]);
+    size_t last = static_cast<unsigned char>(text.back());
+    return (first * 3 + second * 30 + last * 36 + text.size()) & (KeywordSlots - 1);
+}
+
+struct KeywordTable {
+    Keyword slots[KeywordSlots] = {};
+    bool perfect = true;
+};
+
+constexpr KeywordTable buildKeywordTable() {
+    KeywordTable table;
+    for (const Keyword& keyword : Keywords) {
+        Keyword& slot = table.slots[keywordHash(keyword.text)];
+        if (!slot.text.empty() || keyword.text.size() < MinKeywordLength ||
+            keyword.text.size() > MaxKeywordLength) {
+            table.perfect = false;
+        }
+        slot = keyword;
+    }
+    return table;
 }
 
-void Lexer::initKeywords() {
-    keywords_["func"] = TokenType::KwFunc;
-    keywords_["return"] = TokenType::KwReturn;
-    keywords_["if"] = TokenType::KwIf;
-    keywords_["else"] = TokenType::KwElse;
-    keywords_["loopwhile"] = TokenType::KwLoopwhile;
-    keywords_["break"] = TokenType::KwBreak;
-    keywords_["continue"] = TokenType::KwContinue;
-    keywords_["say"] = TokenType::KwSay;
-    keywords_["grab"] = TokenType::KwGrab;
-    keywords_["link"] = TokenType::KwLink;
-    keywords_["fall"] = TokenType::KwFall;
-    keywords_["own"] = TokenType::KwOwn;
-    keywords_["trace"] = TokenType::KwTrace;
-    keywords_["let"] = TokenType::KwLet;
-    keywords_["const"] = TokenType::KwConst;
-    keywords_["type"] = TokenType::KwType;
-    keywords_["struct"] = TokenType::KwStruct;
-    keywords_["enum"] = TokenType::KwEnum;
-    keywords_["impl"] = TokenType::KwImpl;
-    keywords_["trait"] = TokenType::KwTrait;
-    keywords_["for"] = TokenType::KwFor;
-    keywords_["in"] = TokenType::KwIn;
-    keywords_["while"] = TokenType::KwWhile;
-    keywords_["match"] = TokenType::KwMatch;
-    keywords_["import"] = TokenType::KwImport;
-    keywords_["from"] = TokenType::KwFrom;
-    keywords_["async"] = TokenType::KwAsync;
-    keywords_["await"] = TokenType::KwAwait;
-    keywords_["spawn"] = TokenType::KwSpawn;
-    keywords_["true"] = TokenType::KwTrue;
-    keywords_["false"] = TokenType::KwFalse;
-    keywords_["null"] = TokenType::KwNull;
-    keywords_["as"] = TokenType::KwAs;
-    keywords_["is"] = TokenType::KwIs;
-
-    keywords_["i8"] = TokenType::KwI8;
-    keywords_["i16"] = TokenType::KwI16;
-    keywords_["i32"] = TokenType::KwI32;
-    keywords_["i64"] = TokenType::KwI64;
-    keywords_["u8"] = TokenType::KwU8;
-    keywords_["u16"] = TokenType::KwU16;
-    keywords_["u32"] = TokenType::KwU32;
-    keywords_["u64"] = TokenType::KwU64;
-    keywords_["f32"] = TokenType::KwF32;
-    keywords_["f64"] = TokenType::KwF64;
-    keywords_["bool"] = TokenType::KwBool;
-    keywords_["char"] = TokenType::KwChar;
-    keywords_["str"] = TokenType::KwStr;
-    keywords_["void"] = TokenType::KwVoid;
+constexpr KeywordTable KeywordLookup = buildKeywordTable();
+static_assert(KeywordLookup.perfect, "keywordHash collides; pick new multipliers");
+
+// Bulk scanning for the lexer's hot loops. Each scan returns the first position at
+// or after `pos` whose byte stops it, or text.size(). Blocks of 32 (AVX2) or 16
+// (SSE2) bytes are classified at once; the tail falls back to one byte at a time.
+#ifdef XYPHER_LEXER_SIMD
+#if defined(__AVX2__)
+using Block = __m256i;
+constexpr size_t BlockSize = 32;
+inline Block loadBlock(const char* p) { return _mm256_loadu_si256(reinterpret_cast<const Block*>(p)); }
+inline Block splat(char c) { return _mm256_set1_epi8(c); }
+inline Block equal(Block a, Block b) { return _mm256_cmpeq_epi8(a, b); }
+inline Block greater(Block a, Block b) { return _mm256_cmpgt_epi8(a, b); }
+inline Block both(Block a, Block b) { return _mm256_and_si256(a, b); }
+inline Block either(Block a, Block b) { return _mm256_or_si256(a, b); }
+inline uint32_t bitmask(Block v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+#else
+using Block = __m128i;
+constexpr size_t BlockSize = 16;
+inline Block loadBlock(const char* p) { return _mm_loadu_si128(reinterpret_cast<const Block*>(p)); }
+inline Block splat(char c) { return _mm_set1_epi8(c); }
+inline Block equal(Block a, Block b) { return _mm_cmpeq_epi8(a, b); }
+inline Block greater(Block a, Block b) { return _mm_cmpgt_epi8(a, b); }
+inline Block both(Block a, Block b) { return _mm_and_si128(a, b); }
+inline Block either(Block a, Block b) { return _mm_or_si128(a, b); }
+inline uint32_t bitmask(Block v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+#endif
+
+constexpr uint32_t FullMask = BlockSize == 32 ? ~0u : (1u << BlockSize) - 1;
+
+// Signed byte compares, so bytes >= 0x80 fall outside every ASCII range
+inline Block inRange(Block v, char low, char high) {
+    return both(greater(v, splat(static_cast<char>(low - 1))),
+                greater(splat(static_cast<char>(high + 1)), v));
+}
+#endif
+
+// Each Stops functor maps a Block to a bitmask of stopping bytes and a single
+// char to whether it stops the scan; both must agree
+template<typename Stops>
+size_t scanUntil(StringView text, size_t pos, Stops stops) {
+#ifdef XYPHER_LEXER_SIMD
+    while (text.size() - pos >= BlockSize) {
+        uint32_t mask = stops(loadBlock(text.data() + pos));
+        if (mask != 0) {
+            return pos + static_cast<size_t>(std::countr_zero(mask));
+        }
+        pos += BlockSize;
+    }
+#endif
+    while (pos < text.size() && !stops(text[pos])) {
+        pos++;
+    }
+    return pos;
 }
 
+struct NonSpace {
+#ifdef XYPHER_LEXER_SIMD
+    uint32_t operator()(Block v) const {
+        Block spaces = either(either(equal(v, splat(' ')), equal(v, splat('\t'))),
+                              either(equal(v, splat('\n')), equal(v, splat('\r'))));
+        return ~bitmask(spaces) & FullMask;
+    }
+#endif
+    bool operator()(char c) const { return c != ' ' && c != '\t' && c != '\n' && c != '\r'; }
+};
+
+struct NonIdentifierChar {
+#ifdef XYPHER_LEXER_SIMD
+    uint32_t operator()(Block v) const {
+        Block word = either(either(inRange(v, 'a', 'z'), inRange(v, 'A', 'Z')),
+                            either(inRange(v, '0', '9'), equal(v, splat('_'))));
+        return ~bitmask(word) & FullMask;
+    }
+#endif
+    bool operator()(char c) const {
+        return !((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                 c == '_');
+    }
+};
+
+struct QuoteOrEscape {
+#ifdef XYPHER_LEXER_SIMD
+    uint32_t operator()(Block v) const {
+        return bitmask(either(equal(v, splat('"')), equal(v, splat('\\'))));
+    }
+#endif
+    bool operator()(char c) const { return c == '"' || c == '\\'; }
+};
+
+} // namespace
+
+Lexer::Lexer(const SourceManager& sources, FileId file)
+    : sources_(sources), file_(file), source_(sources.getText(file)) {}
+
 char Lexer::peek(size_t offset) const {
     if (current_ + offset >= source_.length()) {
         return '\0';
@@ -72,14 +211,7 @@ char Lexer::advance() {
     if (isAtEnd())
         return '\0';
 
-    char c = source_[current_++];
-    if (c == '\n') {
-        line_++;
-        column_ = 1;
-    } else {
-        column_++;
-    }
-    return c;
+    return source_[current_++];
 }
 
 bool Lexer::match(char expected) {
@@ -97,23 +229,11 @@ bool Lexer::isAtEnd() const {
 }
 
 void Lexer::skipWhitespace() {
-    while (!isAtEnd()) {
-        char c = peek();
-        switch (c) {
-        case ' ':
-        case '\r':
-        case '\t':
-        case '\n':
-            advance();
-            break;
-        case '/':
-            if (peek(1) == '/') {
-                skipComment();
-            } else {
-                return;
-            }
-            break;
-        default:
+    while (true) {
+        current_ = scanUntil(source_, current_, NonSpace());
+        if (peek() == '/' && peek(1) == '/') {
+            skipComment();
+        } else {
             return;
         }
     }
@@ -121,16 +241,17 @@ void Lexer::skipWhitespace() {
 
 void Lexer::skipComment() {
     if (peek() == '/' && peek(1) == '/') {
-        while (!isAtEnd() && peek() != '\n') {
-            advance();
-        }
+        // memchr is already vectorized by the C library
+        const char* begin = source_.data() + current_;
+        const void* newline = std::memchr(begin, '\n', source_.size() - current_);
+        current_ = newline ? current_ + static_cast<size_t>(static_cast<const char*>(newline) - begin)
+                           : source_.size();
     }
 }
 
 Token Lexer::makeToken(TokenType type) {
-    String lexeme = source_.substr(start_, current_ - start_);
-    SourceLocation loc(filename_, line_, column_ - lexeme.length());
-    return Token(type, lexeme, loc);
+    return Token(type, source_.substr(start_, current_ - start_),
+                 SourceLocation(file_, static_cast<uint32_t>(start_)));
 }
 
 Token Lexer::errorToken(const String& message) {
@@ -171,14 +292,14 @@ Token Lexer::number() {
 }
 
 Token Lexer::string() {
-    while (!isAtEnd() && peek() != '"') {
-        if (peek() == '\\') {
-            advance(); // escape sequence
-            if (!isAtEnd())
-                advance();
-        } else {
-            advance();
+    while (true) {
+        current_ = scanUntil(source_, current_, QuoteOrEscape());
+        if (isAtEnd() || peek() == '"') {
+            break;
         }
+        advance(); // escape sequence
+        if (!isAtEnd())
+            advance();
     }
 
     if (isAtEnd()) {
@@ -207,26 +328,25 @@ Token Lexer::character() {
 }
 
 Token Lexer::identifier() {
-    while (std::isalnum(peek()) || peek() == '_') {
-        advance();
-    }
+    current_ = scanUntil(source_, current_, NonIdentifierChar());
 
     return makeToken(identifierType());
 }
 
 TokenType Lexer::identifierType() {
-    String lexeme = source_.substr(start_, current_ - start_);
-    auto it = keywords_.find(lexeme);
-    if (it != keywords_.end()) {
-        return it->second;
+    StringView text = source_.substr(start_, current_ - start_);
+    if (text.size() < MinKeywordLength || text.size() > MaxKeywordLength) {
+        return TokenType::Identifier;
     }
-    return TokenType::Identifier;
+
+    const Keyword& slot = KeywordLookup.slots[keywordHash(text)];
+    return slot.text == text ? slot.type : TokenType::Identifier;
 }
 
 void Lexer::addError(const String& message) {
     hasErrors_ = true;
-    SourceLocation loc(filename_, line_, column_);
-    errors_.push_back(loc.toString() + ": " + message);
+    SourceLocation loc(file_, static_cast<uint32_t>(current_));
+    errors_.push_back(sources_.format(loc) + ": " + message);
 }
 
 Token Lexer::nextToken() {
@@ -333,8 +453,6 @@ Token Lexer::nextToken() {
 Token Lexer::peekToken(size_t ahead) {
     size_t savedStart = start_;
     size_t savedCurrent = current_;
-    size_t savedLine = line_;
-    size_t savedColumn = column_;
 
     Token token = nextToken();
     for (size_t i = 0; i < ahead; i++) {
@@ -343,8 +461,6 @@ Token Lexer::peekToken(size_t ahead) {
 
     start_ = savedStart;
     current_ = savedCurrent;
-    line_ = savedLine;
-    column_ = savedColumn;
 
     return token;
 }
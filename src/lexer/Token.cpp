@@ -22,8 +22,9 @@ bool Token::isType() const {
     return type_ >= TokenType::KwI8 && type_ <= TokenType::KwVoid;
 }
 
-String Token::toString() const {
-    return String(tokenTypeToString(type_)) + " '" + lexeme_ + "' at " + location_.toString();
+String Token::toString(const SourceManager& sources) const {
+    return String(tokenTypeToString(type_)) + " '" + String(lexeme_) + "' at " +
+           sources.format(location_);
 }
 
 const char* tokenTypeToString(TokenType type) {
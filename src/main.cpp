@@ -1,18 +1,39 @@
 #include "Common.h"
 #include "XypherConfig.h"
 #include "ast/ASTDumper.h"
+#include "backend/CompileCache.h"
+#include "backend/JIT.h"
+#include "backend/Linker.h"
+#include "backend/OptRemarks.h"
 #include "backend/Optimizer.h"
+#include "backend/TargetMachine.h"
 #include "codegen/CodeGenerator.h"
+#include "frontend/CompileServer.h"
 #include "frontend/Diagnostics.h"
+#include "frontend/SourceManager.h"
+#include "frontend/TimeReport.h"
 #include "lexer/Lexer.h"
 #include "parser/Parser.h"
 #include "sema/SemanticAnalyzer.h"
 
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/Statistic.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/IR/PassTimingInfo.h>
+#include <llvm/Passes/StandardInstrumentations.h>
+#include <llvm/Support/TimeProfiler.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <thread>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -32,7 +53,7 @@ namespace fs = std::filesystem;
 using namespace xypher;
 
 struct CompilerOptions {
-    String inputFile;
+    Vec<String> inputFiles;
     String outputFile = "output";
     bool emitLLVM = false;
     bool emitASM = false;
@@ -46,31 +67,74 @@ struct CompilerOptions {
     bool printOptStats = false;
     bool emitOptimizedIR = false;
     bool useEnhancedPipeline = true; // Use new pipeline by default
+    bool runMode = false;            // `xypc run`: execute in-process via the JIT
+    Vec<String> programArgs;         // Arguments after `--` in run mode
+    bool jitTiered = false;          // Run mode: -O0 first, hot functions recompiled at -O3
+    uint32_t tierUpThreshold = 1000;
+    bool jitCache = true;            // Run mode: reuse JIT-compiled objects across runs
+    String jitCacheDir;              // Defaults to ~/.cache/xypher
+    TargetConfig target;             // -march/-mcpu/-mattr; empty CPU means generic
+    String serveSocket;              // --serve: run as a compile server on this socket
+    unsigned codegenThreads = 1;     // -j: split each module for parallel codegen
+    bool timeReport = false;         // Print time and memory spent per phase and pass
+    RemarkOptions remarks;           // --opt-remarks, -Rpass, -Rpass-missed
+    ProfileOptions profile;          // --profile-generate, --profile-use
+    bool timeTrace = false;          // Write a Chrome trace of the compilation
+    String timeTraceFile;            // Defaults to <output>.time-trace
+    bool compileCache = true;        // Reuse objects of unchanged sources across builds
+    String compileCacheDir;          // Defaults to ~/.cache/xypher/compile
+    Vec<String> argumentErrors;      // Malformed option values, reported by compile()
 };
 
 void printHelp() {
     std::cout << "Xypher Compiler (xypc) v" << XYPHER_VERSION_STRING << "\n\n";
-    std::cout << "Usage: xypc [options] <input.xyp>\n\n";
+    std::cout << "Usage: xypc [options] <input.xyp>...\n";
+    std::cout << "       xypc run [options] <input.xyp> [-- args...]\n";
+    std::cout << "       xypc --serve <socket>\n";
+    std::cout << "       xypc --connect <socket> [options] <input.xyp>\n\n";
     std::cout << "Options:\n";
     std::cout << "  -o <file>          Output file name\n";
     std::cout << "  --emit-llvm        Emit LLVM IR (optimized if -O used)\n";
     std::cout << "  --emit-opt-ir      Emit optimized LLVM IR\n";
     std::cout << "  --check-syntax     Syntax check only\n";
     std::cout << "  --ast-dump         Dump AST\n";
+    std::cout << "  --debug            Emit DWARF debug info (functions, lines, variables)\n";
     std::cout << "  --verify-ir        Verify IR after optimization\n";
-    std::cout << "  --print-stats      Print optimization statistics\n";
-    std::cout << "  -O<0-3>            Optimization level (with LTO)\n";
-    std::cout << "  -Os                Optimize for size (with LTO)\n";
+    std::cout << "  --print-stats      Print IR counts before/after optimization and LLVM stats\n";
+    std::cout << "  --profile-generate[=F] Instrument the program to write a profile (to F)\n";
+    std::cout << "  --profile-use=F    Optimize with the merged profile F (.profdata)\n";
+    std::cout << "  --opt-remarks=F    Write optimization remarks to F as YAML\n";
+    std::cout << "  -Rpass=R           Print optimizations done by passes matching regex R\n";
+    std::cout << "  -Rpass-missed=R    Print optimizations missed by passes matching regex R\n";
+    std::cout << "  --time-report      Print time and peak memory per phase and per pass\n";
+    std::cout << "  --time-trace[=F]   Write a Chrome trace (chrome://tracing, Perfetto) to F\n";
+    std::cout << "  -O<0-3>            Optimization level (-O2+ inlines from xystd bitcode)\n";
+    std::cout << "  -Os                Optimize for size (inlines from xystd bitcode)\n";
     std::cout << "  -Oz                Aggressive size optimization\n";
     std::cout << "  --size             Maximum size reduction\n";
     std::cout << "  --legacy-opt       Use legacy optimization pipeline\n";
+    std::cout << "  -j <N>             Split each module into N parts for parallel codegen\n";
+    std::cout << "  -march=native      Tune for and use every feature of the host CPU\n";
+    std::cout << "  -mcpu=<cpu>        Target a specific CPU (e.g. skylake, znver3)\n";
+    std::cout << "  -mattr=<features>  Enable/disable features (e.g. +avx2,-sse4a)\n";
+    std::cout << "  --tiered           (run) Start at -O0, recompile hot functions at -O3\n";
+    std::cout << "  --tier-threshold=N (run) Calls before a function is recompiled\n";
+    std::cout << "  --jit-cache-dir=D  (run) Object cache directory (default ~/.cache/xypher)\n";
+    std::cout << "  --no-jit-cache     (run) Always compile, never reuse cached objects\n";
+    std::cout << "  --compile-cache-dir=D Object cache directory (default ~/.cache/xypher/compile)\n";
+    std::cout << "  --no-compile-cache Always compile, never reuse cached objects\n";
+    std::cout << "  --serve <socket>   Stay resident and compile requests sent to <socket>\n";
+    std::cout << "  --connect <socket> Forward this command to a server (also: $XYPC_SERVER)\n";
     std::cout << "  -h, --help         Show help\n";
     std::cout << "  -v, --version      Show version\n";
     std::cout << "\n";
     std::cout << "Examples:\n";
     std::cout << "  xypc main.xyp -o main\n";
+    std::cout << "  xypc src/*.xyp -O2 -o app\n";
     std::cout << "  xypc program.xyp -O2 -o fast\n";
     std::cout << "  xypc program.xyp -Os -o small\n";
+    std::cout << "  xypc program.xyp -O3 -march=native -o native\n";
+    std::cout << "  xypc run script.xyp -- arg1 arg2\n";
 }
 
 void printVersion() {
@@ -78,19 +142,31 @@ void printVersion() {
     std::cout << "Simple compiled language with LLVM backend\n";
 }
 
-CompilerOptions parseArguments(int argc, char* argv[]) {
+CompilerOptions parseArguments(const Vec<String>& args) {
     CompilerOptions opts;
 
-    for (int i = 1; i < argc; i++) {
-        String arg = argv[i];
+    size_t first = 0;
+    if (!args.empty() && args[0] == "run") {
+        opts.runMode = true;
+        first = 1;
+    }
+
+    for (size_t i = first; i < args.size(); i++) {
+        const String& arg = args[i];
 
-        if (arg == "-h" || arg == "--help") {
+        if (opts.runMode && arg == "--") {
+            // Everything after `--` belongs to the program being run
+            for (i++; i < args.size(); i++) {
+                opts.programArgs.push_back(args[i]);
+            }
+            break;
+        } else if (arg == "-h" || arg == "--help") {
             opts.showHelp = true;
         } else if (arg == "-v" || arg == "--version") {
             opts.showVersion = true;
         } else if (arg == "-o") {
-            if (i + 1 < argc) {
-                opts.outputFile = argv[++i];
+            if (i + 1 < args.size()) {
+                opts.outputFile = args[++i];
             }
         } else if (arg == "--emit-llvm") {
             opts.emitLLVM = true;
@@ -106,8 +182,67 @@ CompilerOptions parseArguments(int argc, char* argv[]) {
             opts.verifyIR = true;
         } else if (arg == "--print-stats") {
             opts.printOptStats = true;
+        } else if (arg == "--profile-generate" || arg.rfind("--profile-generate=", 0) == 0) {
+            opts.profile.generate = true;
+            opts.profile.generateFile = arg.size() > 19 ? arg.substr(19) : "";
+        } else if (arg.rfind("--profile-use=", 0) == 0) {
+            opts.profile.useFile = arg.substr(14);
+        } else if (arg.rfind("--opt-remarks=", 0) == 0) {
+            opts.remarks.file = arg.substr(14);
+        } else if (arg.rfind("-Rpass=", 0) == 0) {
+            opts.remarks.passedPattern = arg.substr(7);
+        } else if (arg.rfind("-Rpass-missed=", 0) == 0) {
+            opts.remarks.missedPattern = arg.substr(14);
+        } else if (arg == "--time-report") {
+            opts.timeReport = true;
+        } else if (arg == "--time-trace" || arg.rfind("--time-trace=", 0) == 0) {
+            opts.timeTrace = true;
+            opts.timeTraceFile = arg.size() > 13 ? arg.substr(13) : "";
         } else if (arg == "--legacy-opt") {
             opts.useEnhancedPipeline = false;
+        } else if (arg == "--tiered") {
+            opts.jitTiered = true;
+        } else if (arg.rfind("--tier-threshold=", 0) == 0) {
+            String count = arg.substr(17);
+            unsigned long long threshold = 0;
+            if (count.empty() || count.size() > 10 ||
+                count.find_first_not_of("0123456789") != String::npos ||
+                (threshold = std::stoull(count)) == 0 || threshold > UINT32_MAX) {
+                opts.argumentErrors.push_back("Invalid tier-up threshold '" + count +
+                                              "' (expected 1 to " +
+                                              std::to_string(UINT32_MAX) + " calls)");
+            } else {
+                opts.tierUpThreshold = static_cast<uint32_t>(threshold);
+            }
+        } else if (arg.rfind("--jit-cache-dir=", 0) == 0) {
+            opts.jitCacheDir = arg.substr(16);
+        } else if (arg == "--no-jit-cache") {
+            opts.jitCache = false;
+        } else if (arg.rfind("--compile-cache-dir=", 0) == 0) {
+            opts.compileCacheDir = arg.substr(20);
+        } else if (arg == "--no-compile-cache") {
+            opts.compileCache = false;
+        } else if (arg.rfind("-march=", 0) == 0) {
+            opts.target.cpu = arg.substr(7); // "native" resolves to the host CPU
+        } else if (arg.rfind("-mcpu=", 0) == 0) {
+            opts.target.cpu = arg.substr(6);
+        } else if (arg.rfind("-mattr=", 0) == 0) {
+            opts.target.features = arg.substr(7);
+        } else if (arg == "-j" || (arg.rfind("-j", 0) == 0 && arg.size() > 2)) {
+            String count = arg.size() > 2 ? arg.substr(2) : (i + 1 < args.size() ? args[++i] : "");
+            unsigned long long threads = 0;
+            if (count.empty() || count.size() > 10 ||
+                count.find_first_not_of("0123456789") != String::npos ||
+                (threads = std::stoull(count)) == 0 || threads > UINT32_MAX) {
+                opts.argumentErrors.push_back("Invalid thread count '-j " + count +
+                                              "' (expected a positive number)");
+            } else {
+                opts.codegenThreads = static_cast<unsigned>(threads);
+            }
+        } else if (arg == "--serve") {
+            if (i + 1 < args.size()) {
+                opts.serveSocket = args[++i];
+            }
         } else if (arg == "--debug") {
             opts.debugMode = true;
         } else if (arg == "--size") {
@@ -121,23 +256,33 @@ CompilerOptions parseArguments(int argc, char* argv[]) {
                 opts.optLevel = arg[2] - '0';
             }
         } else if (arg[0] != '-') {
-            opts.inputFile = arg;
+            opts.inputFiles.push_back(arg);
         }
     }
 
+    // Tiered JIT starts from unoptimized IR and optimizes hot functions itself
+    if (opts.runMode && opts.jitTiered) {
+        opts.optLevel = 0;
+    }
+
+    // Run mode executes on this machine, so optimize for it unless told otherwise
+    if (opts.runMode && opts.target.cpu.empty()) {
+        opts.target.cpu = "native";
+    }
+
     return opts;
 }
 
-String readFile(const String& filename) {
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file: " << filename << "\n";
-        return "";
+// Maps the file into memory (for anything larger than a page) rather than copying
+// it; the lexer works directly on the mapped bytes.
+Unique<llvm::MemoryBuffer> readFile(const String& filename) {
+    auto buffer = llvm::MemoryBuffer::getFile(filename, /*IsText=*/false,
+                                              /*RequiresNullTerminator=*/false);
+    if (!buffer) {
+        std::cerr << "Error: Could not open file: " + filename + "\n";
+        return nullptr;
     }
-
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    return buffer.str();
+    return std::move(*buffer);
 }
 
 bool createDirectoryIfNeeded(const String& filepath) {
@@ -175,6 +320,16 @@ fs::path getExecutablePath() {
 #endif
 }
 
+String getStdLibFileName() {
+#ifdef _WIN32
+    return "xystd.dll";
+#elif defined(__APPLE__)
+    return "libxystd.dylib";
+#else
+    return "libxystd.so";
+#endif
+}
+
 fs::path findStdLibPath() {
     // Get compiler executable path
     fs::path exePath = getExecutablePath();
@@ -194,13 +349,7 @@ fs::path findStdLibPath() {
         exeDir / ".." / "lib",        // ../lib
     };
 
-#ifdef _WIN32
-    String libName = "xystd.dll";
-#elif defined(__APPLE__)
-    String libName = "libxystd.dylib";
-#else
-    String libName = "libxystd.so";
-#endif
+    String libName = getStdLibFileName();
 
     for (const auto& searchPath : searchPaths) {
         fs::path libPath = searchPath / libName;
@@ -213,75 +362,77 @@ fs::path findStdLibPath() {
     return exeDir;
 }
 
+// Bitcode build of xystd for link-time optimization; empty if it wasn't built
+String findStdLibBitcode() {
+    fs::path bitcodeFile = findStdLibPath() / "xystd.bc";
+    return fs::exists(bitcodeFile) ? bitcodeFile.string() : "";
+}
+
+// The inputs are native objects already, so there is nothing for -flto to do here;
+// LTO with the standard library happens on the IR (see Linker::linkStdLibBitcode).
 String getCompileFlags(int optLevel) {
     String compileFlags;
 
     if (optLevel >= 2 || optLevel == 4 || optLevel == 5) {
-#if defined(_WIN32)
-        compileFlags = "-O2 -flto -ffunction-sections -fdata-sections";
-#else
-        compileFlags = "-O2 -flto -ffunction-sections -fdata-sections";
-#endif
+        compileFlags = "-O2 -ffunction-sections -fdata-sections";
     } else if (optLevel == 1) {
-        compileFlags = "-O1 -flto";
+        compileFlags = "-O1";
     }
 
     return compileFlags;
 }
 
-String getLinkFlags(int optLevel) {
+// `debugInfo` keeps the symbols and DWARF that stripping would throw away
+String getLinkFlags(int optLevel, bool debugInfo) {
     String linkFlags;
 
     if (optLevel >= 2 || optLevel == 4 || optLevel == 5) {
 #if defined(_WIN32)
-        linkFlags = "-flto -Wl,/LTCG -Wl,/OPT:REF -Wl,/OPT:ICF";
-#else
-        linkFlags = "-flto -Wl,--gc-sections -s";
-#endif
-    } else if (optLevel == 1) {
-#if defined(_WIN32)
-        linkFlags = "-flto -Wl,/LTCG";
+        linkFlags = "-Wl,/OPT:REF -Wl,/OPT:ICF";
 #else
-        linkFlags = "-flto";
+        linkFlags = debugInfo ? "-Wl,--gc-sections" : "-Wl,--gc-sections -s";
 #endif
     }
 
     return linkFlags;
 }
 
-bool linkExecutable(const String& objFile, const String& exeFile, int optLevel) {
+bool linkExecutable(const Vec<String>& objFiles, const String& exeFile, int optLevel,
+                    bool profileRuntime, bool debugInfo) {
     fs::path stdLibPath = findStdLibPath();
 
+    String objArgs;
+    for (const auto& file : objFiles) {
+        objArgs += (objArgs.empty() ? "\"" : " \"") + file + "\"";
+    }
+
     String compileFlags = getCompileFlags(optLevel);
-    String linkFlags = getLinkFlags(optLevel);
+    String linkFlags = getLinkFlags(optLevel, debugInfo);
+    if (profileRuntime) {
+        linkFlags += " -fprofile-generate"; // Pulls in clang's profile runtime
+    }
 
 #ifdef _WIN32
     String dllPath = (stdLibPath / "xystd.dll").string();
 
     if (!fs::exists(dllPath)) {
         String command =
-            "clang " + compileFlags + " " + objFile + " " + linkFlags + " -o " + exeFile + ".exe";
+            "clang " + compileFlags + " " + objArgs + " " + linkFlags + " -o " + exeFile + ".exe";
         return system(command.c_str()) == 0;
     }
 
-    String command = "clang " + compileFlags + " " + objFile + " -L\"" + stdLibPath.string() +
+    String command = "clang " + compileFlags + " " + objArgs + " -L\"" + stdLibPath.string() +
                      "\" -lxystd " + linkFlags + " -o " + exeFile + ".exe";
 #else
-#ifdef __APPLE__
-    String libName = "libxystd.dylib";
-#else
-    String libName = "libxystd.so";
-#endif
-
-    String libPath = (stdLibPath / libName).string();
+    String libPath = (stdLibPath / getStdLibFileName()).string();
 
     if (!fs::exists(libPath)) {
         String command =
-            "clang " + compileFlags + " " + objFile + " " + linkFlags + " -o " + exeFile;
+            "clang " + compileFlags + " " + objArgs + " " + linkFlags + " -o " + exeFile;
         return system(command.c_str()) == 0;
     }
 
-    String command = "clang " + compileFlags + " " + objFile + " -L\"" + stdLibPath.string() +
+    String command = "clang " + compileFlags + " " + objArgs + " -L\"" + stdLibPath.string() +
                      "\" -lxystd -Wl,-rpath,\"" + stdLibPath.string() + "\" " + linkFlags + " -o " +
                      exeFile;
 #endif
@@ -289,127 +440,530 @@ bool linkExecutable(const String& objFile, const String& exeFile, int optLevel)
     return system(command.c_str()) == 0;
 }
 
-int main(int argc, char* argv[]) {
-    CompilerOptions opts = parseArguments(argc, argv);
+using ObjectCode = llvm::SmallVector<char, 0>;
 
-    if (opts.showHelp) {
-        printHelp();
-        return 0;
+// Links straight from memory with the embedded LLD. Returns Unavailable when this
+// build or host can't link in-process, in which case the caller uses clang.
+LinkResult linkInProcess(const Vec<ObjectCode>& objects, const String& exeFile, int optLevel,
+                         bool debugInfo) {
+    fs::path stdLibPath = findStdLibPath();
+
+    LinkJob job;
+    for (const auto& object : objects) {
+        job.objectBuffers.push_back(llvm::StringRef(object.data(), object.size()));
     }
+    job.outputFile = exeFile;
+    if (fs::exists(stdLibPath / getStdLibFileName())) {
+        job.stdLibDir = stdLibPath.string();
+    }
+    job.gcSections = optLevel >= 2;
+    job.strip = optLevel >= 2 && !debugInfo;
 
-    if (opts.showVersion) {
-        printVersion();
-        return 0;
+    return Linker::linkInProcess(job);
+}
+
+// Pins the module to the target before it is optimized, so the optimizer sees the
+// same data layout and TTI cost model that code generation will use.
+llvm::TargetMachine* configureTarget(llvm::Module* module, const TargetConfig& target) {
+    llvm::TargetMachine* targetMachine = TargetMachineManager::getTargetMachine(target);
+    if (!targetMachine) {
+        return nullptr;
     }
 
-    if (opts.inputFile.empty()) {
-        std::cerr << "Error: No input file specified\n";
-        std::cerr << "Use 'xypc --help' for usage information\n";
+#if LLVM_VERSION_MAJOR >= 21
+    module->setTargetTriple(targetMachine->getTargetTriple());
+#else
+    module->setTargetTriple(targetMachine->getTargetTriple().str());
+#endif
+    module->setDataLayout(targetMachine->createDataLayout());
+    return targetMachine;
+}
+
+int runInJIT(CodeGenerator& codegen, const String& inputFile, const CompilerOptions& opts) {
+    llvm::Function* mainFunc = codegen.getModule()->getFunction("main");
+    if (!mainFunc || mainFunc->isDeclaration()) {
+        std::cerr << "Error: No 'main' function in " << inputFile << "\n";
         return 1;
     }
+    bool mainReturnsVoid = mainFunc->getReturnType()->isVoidTy();
 
-    String source = readFile(opts.inputFile);
-    if (source.empty()) {
-        std::cerr << "Error: Cannot read file: " << opts.inputFile << "\n";
+    JITOptions jitOptions;
+    jitOptions.tiered = opts.jitTiered;
+    jitOptions.tierUpThreshold = opts.tierUpThreshold;
+    jitOptions.target = opts.target;
+    if (opts.jitCache) {
+        jitOptions.cacheDirectory =
+            opts.jitCacheDir.empty() ? PersistentObjectCache::defaultDirectory() : opts.jitCacheDir;
+    }
+
+    JITEngine jit(jitOptions);
+    if (!jit.isReady()) {
+        std::cerr << "Error: Could not initialize JIT\n";
         return 1;
     }
 
-    DiagnosticEngine diags;
-    Lexer lexer(source, opts.inputFile);
-    Parser parser(lexer, diags);
+    fs::path stdLibFile = findStdLibPath() / getStdLibFileName();
+    if (fs::exists(stdLibFile) && !jit.addLibrary(stdLibFile.string())) {
+        std::cerr << "Error: Could not load standard library: " << stdLibFile.string() << "\n";
+        return 1;
+    }
 
-    auto program = parser.parseProgram();
+    auto module = codegen.takeModule();
+    auto context = codegen.takeContext();
+    if (!jit.addModule(std::move(module), std::move(context))) {
+        std::cerr << "Error: JIT compilation failed\n";
+        return 1;
+    }
+
+    int exitCode = jit.runMain(inputFile, opts.programArgs);
+    return mainReturnsVoid ? 0 : exitCode;
+}
+
+// Result of running the pipeline over one source file
+struct UnitResult {
+    int exitCode = 0;
+    bool hasObject = false; // False for modes that stop before object emission
+    Vec<ObjectCode> objects;
+};
+
+// Only plain object builds are cached; every other mode needs the pipeline to run
+bool canUseCompileCache(const CompilerOptions& opts) {
+    return opts.compileCache && !opts.runMode && !opts.checkSyntaxOnly && !opts.dumpAST &&
+           !opts.emitLLVM && !opts.emitOptimizedIR && !opts.emitASM && !opts.verifyIR &&
+           !opts.printOptStats && !opts.remarks.enabled();
+}
+
+// Identifies a version of an input file without reading it
+String describeFile(const String& path) {
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    auto modified = fs::last_write_time(path, ec).time_since_epoch().count();
+    return path + " " + std::to_string(size) + " " + std::to_string(modified);
+}
+
+// Everything besides the source text that decides what a file compiles to
+String describeCompilation(const String& inputFile, const CompilerOptions& opts) {
+    String context = inputFile + "\n";
+    context += "O" + std::to_string(opts.optLevel) + (opts.useEnhancedPipeline ? "" : " legacy");
+    context += opts.debugMode ? " debug" : "";
+    context += " j" + std::to_string(opts.codegenThreads) + "\n";
+
+    // The resolved target, so that "native" differs between machines
+    if (llvm::TargetMachine* tm = TargetMachineManager::getTargetMachine(opts.target)) {
+        context += tm->getTargetTriple().str() + ";" + tm->getTargetCPU().str() + ";" +
+                   tm->getTargetFeatureString().str() + "\n";
+    }
+
+    // A rebuilt xystd.bc changes what gets inlined
+    String stdLibBitcode = opts.optLevel >= 2 ? findStdLibBitcode() : "";
+    if (!stdLibBitcode.empty()) {
+        context += "xystd.bc " + describeFile(stdLibBitcode) + "\n";
+    }
+
+    if (opts.profile.generate) {
+        context += "profile-generate " + opts.profile.generateFile + "\n";
+    }
+    if (!opts.profile.useFile.empty()) {
+        context += "profile-use " + describeFile(opts.profile.useFile) + "\n";
+    }
+
+    context += ModuleRegistry::instance().fingerprint();
+    return context;
+}
+
+// Lexes, parses, analyzes, generates, optimizes and emits one file. Every unit gets
+// its own DiagnosticEngine and LLVMContext (inside CodeGenerator), so units can be
+// compiled on different threads.
+// `unitName` tells this unit's outputs apart from the others'; empty for a single input
+UnitResult compileUnit(const String& inputFile, const String& unitName,
+                       const CompilerOptions& opts, const CompileCache* cache,
+                       TimeReport* timeReport) {
+    String outputBase = unitName.empty() ? opts.outputFile : opts.outputFile + "." + unitName;
+    UnitResult result;
+    result.exitCode = 1;
+
+    llvm::TimeTraceScope fileScope("CompileFile", inputFile);
+
+    Unique<llvm::MemoryBuffer> sourceBuffer;
+    {
+        TimeReport::Scope timer(timeReport, CompilePhase::Read);
+        sourceBuffer = readFile(inputFile);
+    }
+    if (!sourceBuffer || sourceBuffer->getBufferSize() == 0) {
+        std::cerr << "Error: Cannot read file: " + inputFile + "\n";
+        return result;
+    }
+    if (sourceBuffer->getBufferSize() > UINT32_MAX) {
+        std::cerr << "Error: Source files must be smaller than 4 GiB: " + inputFile + "\n";
+        return result;
+    }
+    llvm::StringRef source = sourceBuffer->getBuffer();
+
+    String cacheKey;
+    if (cache) {
+        cacheKey = cache->computeKey(source, describeCompilation(inputFile, opts));
+        if (cache->lookup(cacheKey, result.objects)) {
+            result.exitCode = 0;
+            result.hasObject = true;
+            return result;
+        }
+    }
+
+    SourceManager sources;
+    FileId file = sources.addFile(inputFile, StringView(source.data(), source.size()));
+    DiagnosticEngine diags(sources);
+    Lexer lexer(sources, file);
+
+    Unique<Program> program;
+    {
+        llvm::TimeTraceScope traceScope("lex+parse");
+        std::chrono::nanoseconds lexTime{0};
+        Stopwatch stopwatch;
+
+        Parser parser(lexer, diags, timeReport ? &lexTime : nullptr);
+        program = parser.parseProgram();
+
+        // Tokens are lexed on demand while parsing; split the lexer's share off
+        if (timeReport) {
+            PhaseTimes times = stopwatch.elapsed();
+            double lexSeconds = std::chrono::duration<double>(lexTime).count();
+            double lexShare = times.wall > 0.0 ? std::min(1.0, lexSeconds / times.wall) : 0.0;
+            timeReport->add(CompilePhase::Lex, times * lexShare);
+            timeReport->add(CompilePhase::Parse, times * (1.0 - lexShare));
+        }
+    }
 
     if (diags.hasErrors()) {
-        return 1;
+        return result;
     }
 
     if (opts.checkSyntaxOnly) {
-        std::cout << "Syntax OK\n";
-        return 0;
+        std::cout << (opts.inputFiles.size() > 1 ? inputFile + ": Syntax OK\n" : "Syntax OK\n");
+        result.exitCode = 0;
+        return result;
     }
 
     if (opts.dumpAST) {
         ASTDumper dumper;
         dumper.dump(program.get());
-        return 0;
+        result.exitCode = 0;
+        return result;
     }
 
-    SemanticAnalyzer analyzer(diags);
-    if (!analyzer.analyze(program.get())) {
-        return 1;
+    {
+        TimeReport::Scope timer(timeReport, CompilePhase::Sema);
+        SemanticAnalyzer analyzer(diags);
+        if (!analyzer.analyze(program.get())) {
+            return result;
+        }
     }
 
-    CodeGenerator codegen(opts.inputFile, diags);
+    // Remarks point back at the source, which needs locations on the IR
+    DebugInfoLevel debugInfo = DebugInfoLevel::None;
+    if (opts.debugMode) {
+        debugInfo = DebugInfoLevel::Full;
+    } else if (opts.remarks.enabled()) {
+        debugInfo = DebugInfoLevel::LocationsOnly;
+    }
+    CodeGenerator codegen(inputFile, diags, debugInfo, opts.optLevel > 0);
 
-    if (!codegen.generate(program.get())) {
-        return 1;
+    Unique<OptRemarks> remarks;
+    if (opts.remarks.enabled()) {
+        RemarkOptions remarkOptions = opts.remarks;
+        if (!unitName.empty() && !remarkOptions.file.empty()) {
+            // remarks.yaml -> remarks.<unit>.yaml, one file per unit
+            llvm::SmallString<256> path(remarkOptions.file);
+            String extension = llvm::sys::path::extension(path).str();
+            llvm::sys::path::replace_extension(path, unitName + extension);
+            remarkOptions.file = path.str().str();
+        }
+        remarks = OptRemarks::enable(codegen.getModule()->getContext(), remarkOptions);
+        if (!remarks) {
+            return result;
+        }
+    }
+
+    llvm::TargetMachine* targetMachine;
+    {
+        TimeReport::Scope timer(timeReport, CompilePhase::CodeGen);
+        if (!codegen.generate(program.get())) {
+            return result;
+        }
+
+        targetMachine = configureTarget(codegen.getModule(), opts.target);
+        if (!targetMachine) {
+            std::cerr << "Error: Could not create target machine\n";
+            return result;
+        }
     }
 
     // Run LLVM IR optimization passes
     if (opts.optLevel > 0) {
         OptimizationLevel level = static_cast<OptimizationLevel>(opts.optLevel);
 
-        String optStr = "O" + std::to_string(opts.optLevel);
-        if (opts.optLevel == 4)
-            optStr = "Os";
-        if (opts.optLevel == 5)
-            optStr = "Oz";
-        std::cout << "Optimizing (" << optStr << ")...\n";
+        llvm::PassInstrumentationCallbacks instrumentation;
+        llvm::TimePassesHandler passTimer(timeReport != nullptr);
+        String passTimings;
+        llvm::raw_string_ostream passTimingStream(passTimings);
+        passTimer.setOutStream(passTimingStream);
+        passTimer.registerCallbacks(instrumentation);
+        llvm::TimeProfilingPassesHandler passTracer;
+        passTracer.registerCallbacks(instrumentation);
 
-        if (opts.useEnhancedPipeline) {
-            Optimizer::optimizeWithPipeline(codegen.getModule(), level);
-        } else {
-            std::cout << "[Using legacy optimization pipeline]\n";
-            Optimizer::optimize(codegen.getModule(), level);
+        // LTO with the standard library, so its small functions can be inlined
+        if (opts.optLevel >= 2) {
+            String stdLibBitcode = findStdLibBitcode();
+            if (!stdLibBitcode.empty()) {
+                TimeReport::Scope timer(timeReport, CompilePhase::Optimize);
+                Linker::linkStdLibBitcode(*codegen.getModule(), stdLibBitcode);
+            }
+        }
+
+        ModuleStats statsBefore;
+        if (opts.printOptStats) {
+            statsBefore = Optimizer::collectStats(*codegen.getModule());
+        }
+
+        {
+            TimeReport::Scope timer(timeReport, CompilePhase::Optimize);
+            if (opts.useEnhancedPipeline) {
+                Optimizer::optimizeWithPipeline(codegen.getModule(), level, targetMachine,
+                                                &instrumentation, opts.profile);
+            } else {
+                Optimizer::optimize(codegen.getModule(), level, targetMachine, &instrumentation,
+                                    opts.profile);
+            }
+        }
+
+        if (timeReport) {
+            passTimer.print();
+            timeReport->addPassTimings(passTimingStream.str());
         }
 
         // Verify IR if requested
         if (opts.verifyIR) {
-            std::cout << "Verifying IR...\n";
             if (Optimizer::verifyModule(codegen.getModule(), true)) {
-                std::cout << "[OK] IR verification passed\n";
+                std::cout << "[OK] IR verification passed: " + inputFile + "\n";
             }
         }
 
         // Print optimization statistics if requested
         if (opts.printOptStats) {
-            Optimizer::printOptimizationStats(codegen.getModule());
+            // One write per unit so parallel units don't interleave their tables
+            std::ostringstream stats;
+            Optimizer::printOptimizationStats(statsBefore, codegen.getModule(), stats);
+            std::cout << stats.str();
         }
-    } else {
-        std::cout << "Compiling (no optimization)...\n";
+    }
+
+    // Script mode: skip object emission and linking entirely
+    if (opts.runMode) {
+        remarks.reset(); // The JIT takes over the context
+        result.exitCode = runInJIT(codegen, inputFile, opts);
+        return result;
     }
 
     // Emit optimized IR if requested
     if (opts.emitOptimizedIR) {
-        String optIRFile = opts.outputFile + ".opt.ll";
+        String optIRFile = outputBase + ".opt.ll";
         codegen.emitLLVMIR(optIRFile);
-        std::cout << "Optimized IR: " << optIRFile << "\n";
-    }
-
-    if (!createDirectoryIfNeeded(opts.outputFile)) {
-        return 1;
+        std::cout << "Optimized IR: " + optIRFile + "\n";
     }
 
     if (opts.emitLLVM) {
-        String llFile = opts.outputFile + ".ll";
+        String llFile = outputBase + ".ll";
         codegen.emitLLVMIR(llFile);
-        std::cout << "Generated: " << llFile << "\n";
-        return 0;
+        std::cout << "Generated: " + llFile + "\n";
+        result.exitCode = 0;
+        return result;
     }
 
     if (opts.emitASM) {
         std::cout << "Assembly output not implemented\n";
+        result.exitCode = 0;
+        return result;
+    }
+
+    {
+        TimeReport::Scope timer(timeReport, CompilePhase::Emit);
+        if (!codegen.compileToObjects(result.objects, opts.codegenThreads, opts.target)) {
+            std::cerr << "Failed to compile " + inputFile + "\n";
+            return result;
+        }
+    }
+
+    // A hit prints nothing, so units with warnings keep compiling until they're fixed
+    if (cache && diags.getWarningCount() == 0) {
+        cache->store(cacheKey, result.objects);
+    }
+
+    result.exitCode = 0;
+    result.hasObject = true;
+    return result;
+}
+
+// Per-unit output names: each input's stem, e.g. <out>.util.ll. Inputs that share a
+// stem (a/util.xyp, b/util.xyp) get their position appended (util-0, util-1), so
+// parallel workers never write the same file. Empty for a single input.
+Vec<String> unitNames(const Vec<String>& inputs) {
+    if (inputs.size() == 1) {
+        return {""};
+    }
+
+    Map<String, size_t> stemCounts;
+    for (const auto& input : inputs) {
+        stemCounts[fs::path(input).stem().string()]++;
+    }
+
+    Vec<String> names;
+    Set<String> taken;
+    for (const auto& [stem, count] : stemCounts) {
+        if (count == 1) {
+            taken.insert(stem);
+        }
+    }
+    for (size_t i = 0; i < inputs.size(); i++) {
+        String name = fs::path(inputs[i]).stem().string();
+        if (stemCounts[name] > 1) {
+            name += "-" + std::to_string(i);
+            while (!taken.insert(name).second) {
+                name += "_";
+            }
+        }
+        names.push_back(name);
+    }
+    return names;
+}
+
+// Compiles every input on a pool of worker threads. Each idle worker takes the next
+// file that nobody has started yet, so a few large files don't hold up the rest.
+Vec<UnitResult> compileUnits(const CompilerOptions& opts, TimeReport* timeReport) {
+    const Vec<String>& inputs = opts.inputFiles;
+    Vec<UnitResult> results(inputs.size());
+
+    Unique<CompileCache> cache;
+    if (canUseCompileCache(opts)) {
+        String directory =
+            opts.compileCacheDir.empty() ? CompileCache::defaultDirectory() : opts.compileCacheDir;
+        if (!directory.empty()) {
+            cache = makeUnique<CompileCache>(directory);
+        }
+    }
+
+    Vec<String> names = unitNames(inputs);
+
+    // Dumps and syntax checks write freely to stdout; keep them in input order
+    size_t workers = 1;
+    if (!opts.checkSyntaxOnly && !opts.dumpAST) {
+        workers = std::min<size_t>(inputs.size(), std::max(1u, std::thread::hardware_concurrency()));
+    }
+
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t i = next++; i < inputs.size(); i = next++) {
+            results[i] = compileUnit(inputs[i], names[i], opts, cache.get(), timeReport);
+        }
+    };
+
+    // The time profiler is per thread; workers join the trace of the calling thread
+    bool tracing = llvm::timeTraceProfilerEnabled();
+
+    Vec<std::thread> pool;
+    for (size_t i = 1; i < workers; i++) {
+        pool.emplace_back([&work, tracing] {
+            if (tracing) {
+                llvm::timeTraceProfilerInitialize(0, "xypc");
+            }
+            work();
+            if (tracing) {
+                llvm::timeTraceProfilerFinishThread();
+            }
+        });
+    }
+    work();
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    return results;
+}
+
+// Compiles all inputs and links the executable
+int build(const CompilerOptions& opts, TimeReport* timeReport) {
+    bool producesCode = !opts.checkSyntaxOnly && !opts.dumpAST;
+    if (producesCode && !opts.runMode) {
+        if (opts.optLevel > 0) {
+            String optStr = "O" + std::to_string(opts.optLevel);
+            if (opts.optLevel == 4)
+                optStr = "Os";
+            if (opts.optLevel == 5)
+                optStr = "Oz";
+            std::cout << "Optimizing (" << optStr << ")...\n";
+            if (!opts.useEnhancedPipeline) {
+                std::cout << "[Using legacy optimization pipeline]\n";
+            }
+        } else {
+            std::cout << "Compiling (no optimization)...\n";
+        }
+
+        if (!createDirectoryIfNeeded(opts.outputFile)) {
+            return 1;
+        }
+    }
+
+    Vec<UnitResult> results = compileUnits(opts, timeReport);
+
+    Vec<ObjectCode> objects;
+    for (auto& result : results) {
+        if (result.exitCode != 0 || !result.hasObject) {
+            // Either a unit failed or this mode stops before linking
+            if (result.exitCode != 0 || results.size() == 1) {
+                return result.exitCode;
+            }
+            continue;
+        }
+        for (auto& object : result.objects) {
+            objects.push_back(std::move(object));
+        }
+    }
+
+    if (objects.empty()) {
         return 0;
     }
 
-    String objFile = opts.outputFile + ".o";
-    if (!codegen.compileToObject(objFile)) {
-        std::cerr << "Failed to compile\n";
+    TimeReport::Scope linkTimer(timeReport, CompilePhase::Link);
+
+    // The profile runtime ships with clang, so instrumented programs link through it
+    LinkResult linked = opts.profile.generate
+                            ? LinkResult::Unavailable
+                            : linkInProcess(objects, opts.outputFile, opts.optLevel,
+                                            opts.debugMode);
+    if (linked == LinkResult::Failure) {
+        std::cerr << "Linking failed\n";
         return 1;
     }
 
-    if (!linkExecutable(objFile, opts.outputFile, opts.optLevel)) {
+    if (linked == LinkResult::Success) {
+        std::cout << "Output: " << opts.outputFile << "\n";
+        return 0;
+    }
+
+    // Fallback: write the objects out and link through the clang driver
+    Vec<String> objFiles;
+    for (size_t i = 0; i < objects.size(); i++) {
+        String objFile = objects.size() == 1 ? opts.outputFile + ".o"
+                                             : opts.outputFile + "." + std::to_string(i) + ".o";
+        std::ofstream objStream(objFile, std::ios::binary);
+        objStream.write(objects[i].data(), static_cast<std::streamsize>(objects[i].size()));
+        if (!objStream) {
+            std::cerr << "Failed to compile\n";
+            return 1;
+        }
+        objFiles.push_back(objFile);
+    }
+
+    if (!linkExecutable(objFiles, opts.outputFile, opts.optLevel, opts.profile.generate,
+                        opts.debugMode)) {
         std::cerr << "Linking failed\n";
         return 1;
     }
@@ -422,3 +976,125 @@ int main(int argc, char* argv[]) {
 
     return 0;
 }
+
+int compile(CompilerOptions opts) {
+    if (opts.showHelp) {
+        printHelp();
+        return 0;
+    }
+
+    if (opts.showVersion) {
+        printVersion();
+        return 0;
+    }
+
+    for (const auto& error : opts.argumentErrors) {
+        std::cerr << "Error: " << error << "\n";
+    }
+    if (!opts.argumentErrors.empty()) {
+        return 1;
+    }
+
+    if (opts.inputFiles.empty()) {
+        std::cerr << "Error: No input file specified\n";
+        std::cerr << "Use 'xypc --help' for usage information\n";
+        return 1;
+    }
+
+    if (opts.runMode && opts.inputFiles.size() > 1) {
+        std::cerr << "Error: 'xypc run' takes a single input file\n";
+        return 1;
+    }
+
+    if (opts.runMode && opts.profile.generate) {
+        std::cerr << "Error: --profile-generate needs a linked executable, not 'xypc run'\n";
+        return 1;
+    }
+
+    if (!opts.profile.useFile.empty() && !fs::exists(opts.profile.useFile)) {
+        std::cerr << "Error: Profile not found: " << opts.profile.useFile << "\n";
+        return 1;
+    }
+
+    if (opts.profile.enabled() && opts.optLevel == 0) {
+        std::cerr << "Warning: --profile-generate and --profile-use need -O1 or higher\n";
+    }
+
+    Unique<TimeReport> timeReport;
+    if (opts.timeReport) {
+        timeReport = makeUnique<TimeReport>();
+        llvm::TimePassesIsEnabled = true; // Codegen (legacy pass manager) pass timers
+    }
+
+    if (opts.timeTrace) {
+        llvm::timeTraceProfilerInitialize(0, "xypc");
+    }
+
+    if (opts.printOptStats) {
+        llvm::EnableStatistics(false); // Printed below, together with the timings
+    }
+
+    int exitCode = build(opts, timeReport.get());
+
+    if (opts.timeTrace) {
+        if (auto err = llvm::timeTraceProfilerWrite(opts.timeTraceFile, opts.outputFile)) {
+            std::cerr << "Error: Could not write time trace: " << llvm::toString(std::move(err))
+                      << "\n";
+        }
+        llvm::timeTraceProfilerCleanup();
+    }
+
+    if (opts.printOptStats) {
+        std::cout.flush();
+        if (llvm::GetStatistics().empty()) {
+            std::cerr << "Note: LLVM pass statistics need an LLVM built with assertions or "
+                         "LLVM_FORCE_ENABLE_STATS\n";
+        } else {
+            llvm::PrintStatistics(llvm::errs());
+        }
+    }
+
+    if (timeReport) {
+        timeReport->print(std::cerr);
+        std::cerr.flush();
+        llvm::reportAndResetTimings(&llvm::errs());
+    }
+
+    return exitCode;
+}
+
+// Done once in the server so that every forked request starts with it in place
+void warmUpCompiler() {
+    ModuleRegistry::instance();
+    TargetMachineManager::getTargetMachine(TargetConfig());
+}
+
+int serveRequest(const Vec<String>& args) {
+    CompilerOptions opts = parseArguments(args);
+    if (!opts.serveSocket.empty()) {
+        std::cerr << "Error: --serve cannot be sent to a compile server\n";
+        return 1;
+    }
+    return compile(opts);
+}
+
+int main(int argc, char* argv[]) {
+    Vec<String> args(argv + 1, argv + argc);
+
+    String server = CompileServer::takeServerSocket(args);
+    bool serving = std::find(args.begin(), args.end(), "--serve") != args.end();
+    if (!server.empty() && !serving) {
+        if (auto exitCode = CompileServer::forward(server, args)) {
+            return *exitCode;
+        }
+        // Nobody listening: compile in this process instead
+    }
+
+    CompilerOptions opts = parseArguments(args);
+    if (!opts.serveSocket.empty()) {
+        warmUpCompiler();
+        return CompileServer::serve(opts.serveSocket, serveRequest);
+    }
+
+    return compile(opts);
+}
@@ -2,18 +2,24 @@
 
 namespace xypher {
 
-Parser::Parser(Lexer& lexer, DiagnosticEngine& diags)
-    : lexer_(lexer), diags_(diags), current_(Token(TokenType::Unknown, "", SourceLocation())),
+Parser::Parser(Lexer& lexer, DiagnosticEngine& diags, std::chrono::nanoseconds* lexTime)
+    : lexer_(lexer), diags_(diags), lexTime_(lexTime), current_(Token(TokenType::Unknown, "", SourceLocation())),
       previous_(Token(TokenType::Unknown, "", SourceLocation())) {
     advance();
 }
 
 void Parser::advance() {
     previous_ = current_;
-    current_ = lexer_.nextToken();
+    if (lexTime_) {
+        auto start = std::chrono::steady_clock::now();
+        current_ = lexer_.nextToken();
+        *lexTime_ += std::chrono::steady_clock::now() - start;
+    } else {
+        current_ = lexer_.nextToken();
+    }
     
     // Debug: print token (uncomment for debugging)
-    // std::cerr << "DEBUG Token: " << current_.toString() << "\n";
+    // std::cerr << "DEBUG Token: " << current_.toString(diags_.getSourceManager()) << "\n";
     
     if (current_.is(TokenType::Unknown)) {
         errorAtCurrent("Unknown token");
@@ -118,7 +124,7 @@ Unique<Stmt> Parser::funcDecl() {
     if (!consume(TokenType::Identifier, "Expected function name")) {
         return nullptr;
     }
-    String name = previous_.getLexeme();
+    String name(previous_.getLexeme());
     
     if (!consume(TokenType::LeftParen, "Expected '(' after function name")) {
         return nullptr;
@@ -153,7 +159,7 @@ Unique<Stmt> Parser::importDecl() {
     if (!consume(TokenType::Identifier, "Expected module name after 'import'")) {
         return nullptr;
     }
-    String module = previous_.getLexeme();
+    String module(previous_.getLexeme());
     
     if (!consume(TokenType::KwFrom, "Expected 'from' after module name")) {
         return nullptr;
@@ -162,7 +168,7 @@ Unique<Stmt> Parser::importDecl() {
     if (!consume(TokenType::Identifier, "Expected source library name after 'from'")) {
         return nullptr;
     }
-    String source = previous_.getLexeme();
+    String source(previous_.getLexeme());
     
     if (!consume(TokenType::Semicolon, "Expected ';' after import statement")) {
         return nullptr;
@@ -179,7 +185,7 @@ Unique<Stmt> Parser::varDecl() {
     if (!consume(TokenType::Identifier, "Expected variable name")) {
         return nullptr;
     }
-    String name = previous_.getLexeme();
+    String name(previous_.getLexeme());
     
     Unique<TypeNode> type;
     if (match(TokenType::Colon)) {
@@ -233,9 +239,7 @@ Unique<Stmt> Parser::blockStatement() {
     
     while (!check(TokenType::RightBrace) && !isAtEnd()) {
         // Safety: if token didn't advance and we had error, break to avoid infinite loop
-        if (current_.getLexeme() == lastToken.getLexeme() && 
-            current_.getLocation().getLine() == lastToken.getLocation().getLine() &&
-            current_.getLocation().getColumn() == lastToken.getLocation().getColumn()) {
+        if (current_.getLocation() == lastToken.getLocation()) {
             errorCount++;
             if (errorCount > 3) {
                 error("Parser stuck, skipping to next token");
@@ -580,19 +584,19 @@ Unique<Expr> Parser::primary() {
     }
     
     if (match(TokenType::IntegerLiteral)) {
-        String lexeme = previous_.getLexeme();
+        String lexeme(previous_.getLexeme());
         int64_t value = std::stoll(lexeme);
         return makeUnique<IntegerLiteral>(value, loc);
     }
     
     if (match(TokenType::FloatLiteral)) {
-        String lexeme = previous_.getLexeme();
+        String lexeme(previous_.getLexeme());
         double value = std::stod(lexeme);
         return makeUnique<FloatLiteral>(value, loc);
     }
     
     if (match(TokenType::StringLiteral)) {
-        String lexeme = previous_.getLexeme();
+        String lexeme(previous_.getLexeme());
         // Remove quotes and process escape sequences
         String raw = lexeme.substr(1, lexeme.length() - 2);
         String value;
@@ -617,7 +621,7 @@ Unique<Expr> Parser::primary() {
     }
     
     if (match(TokenType::Identifier)) {
-        String name = previous_.getLexeme();
+        String name(previous_.getLexeme());
         return makeUnique<Identifier>(name, loc);
     }
     
@@ -640,7 +644,7 @@ Unique<TypeNode> Parser::parseType() {
               TokenType::KwU8, TokenType::KwU16, TokenType::KwU32, TokenType::KwU64,
               TokenType::KwF32, TokenType::KwF64, TokenType::KwBool, TokenType::KwChar,
               TokenType::KwStr, TokenType::KwVoid, TokenType::Identifier)) {
-        String typeName = previous_.getLexeme();
+        String typeName(previous_.getLexeme());
         return makeUnique<TypeName>(typeName, loc);
     }
     
@@ -654,7 +658,7 @@ Vec<Parameter> Parser::parseParameters() {
     if (!check(TokenType::RightParen)) {
         do {
             consume(TokenType::Identifier, "Expected parameter name");
-            String name = previous_.getLexeme();
+            String name(previous_.getLexeme());
             auto loc = previous_.getLocation();
             
             consume(TokenType::Colon, "Expected ':' after parameter name");
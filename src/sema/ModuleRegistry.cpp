@@ -1,5 +1,7 @@
 #include "sema/ModuleRegistry.h"
 
+#include <algorithm>
+
 namespace xypher {
 
 void ModuleRegistry::registerFunction(const String& module, const String& name, const String& type) {
@@ -67,6 +69,11 @@ void ModuleRegistry::initializeModules() {
     registerFunction("memory", "xy_free", "void");
 }
 
+const ModuleRegistry& ModuleRegistry::instance() {
+    static const ModuleRegistry registry;
+    return registry;
+}
+
 Vec<Symbol> ModuleRegistry::getModuleFunctions(const String& moduleName) const {
     auto it = moduleMap_.find(moduleName);
     if (it != moduleMap_.end()) {
@@ -83,4 +90,20 @@ bool ModuleRegistry::isValidModule(const String& moduleName) const {
     return moduleMap_.find(moduleName) != moduleMap_.end();
 }
 
+String ModuleRegistry::fingerprint() const {
+    Vec<String> modules;
+    for (const auto& [name, functions] : moduleMap_) {
+        modules.push_back(name);
+    }
+    std::sort(modules.begin(), modules.end());
+
+    String result;
+    for (const auto& module : modules) {
+        for (const auto& sym : moduleMap_.at(module)) {
+            result += module + "." + sym.name + ":" + sym.type + "\n";
+        }
+    }
+    return result;
+}
+
 } // namespace xypher
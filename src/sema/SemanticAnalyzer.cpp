@@ -2,6 +2,8 @@
 #include "sema/TypeChecker.h"
 #include "sema/ModuleRegistry.h"
 
+#include <llvm/Support/TimeProfiler.h>
+
 namespace xypher {
 
 SemanticAnalyzer::SemanticAnalyzer(DiagnosticEngine& diags) : diags_(diags) {}
@@ -240,6 +242,8 @@ void SemanticAnalyzer::visit(TraceStmt* node) {
 }
 
 void SemanticAnalyzer::visit(FuncDecl* node) {
+    llvm::TimeTraceScope timeScope("SemaFunction", [&] { return node->getName(); });
+
     currentFunction_ = node->getName();
     currentReturnType_ = node->getReturnType() ? node->getReturnType()->getTypeName() : "void";
 